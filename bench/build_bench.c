@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#define _POSIX_C_SOURCE 200809L // clock_gettime, sysconf
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "build.h"
+#include "map.h"
+#include "pool.h"
+
+// Loads argv[1] random keys (4M by default) into a presized map one
+// hashmap_add at a time, then through hashmap_build serially and with pools
+// of 2, 4, ... threads up to the CPU count (or argv[2]).
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void report(const char *mode, int threads, int n, double elapsed,
+                   double baseline)
+{
+    printf("%-10s %8d %12.2f %10.2f\n", mode, threads, n / elapsed / 1e6,
+           baseline / elapsed);
+}
+
+int main(int argc, char **argv)
+{
+    int n = argc > 1 ? atoi(argv[1]) : 1 << 22;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_threads = argc > 2 ? atoi(argv[2]) : (cpus > 0 ? (int)cpus : 1);
+
+    char **keys = (char **)calloc(n, sizeof(char *));
+    value_t *values = (value_t *)calloc(n, sizeof(value_t));
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    for (int i = 0; i < n; ++i) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        keys[i] = (char *)calloc(24, sizeof(char));
+        sprintf(keys[i], "%016llx", (unsigned long long)state);
+        values[i] = _number_to_value((double)i);
+    }
+
+    printf("%-10s %8s %12s %10s\n", "mode", "threads", "Mkeys/s", "speedup");
+    double begin = now_seconds();
+    hashmap_t map = hashmap_init((int)(n / 0.75) + 1, 0.75, _default_hasher);
+    for (int i = 0; i < n; ++i)
+        hashmap_add(&map, keys[i], values[i]);
+    double serial = now_seconds() - begin;
+    report("add", 1, n, serial, serial);
+    hashmap_free(&map);
+
+    begin = now_seconds();
+    map = hashmap_build((const char **)keys, values, n, 0.75, NULL);
+    report("build", 1, n, now_seconds() - begin, serial);
+    hashmap_free(&map);
+
+    for (int threads = 2; threads <= max_threads; threads *= 2) {
+        hashmap_pool_t *pool = hashmap_pool_open(threads);
+        begin = now_seconds();
+        map = hashmap_build((const char **)keys, values, n, 0.75, pool);
+        report("build", threads, n, now_seconds() - begin, serial);
+        hashmap_free(&map);
+        hashmap_pool_close(pool);
+    }
+
+    for (int i = 0; i < n; ++i)
+        free(keys[i]);
+    free(keys);
+    free(values);
+    return EXIT_SUCCESS;
+}
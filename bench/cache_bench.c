@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cache.h"
+#include "map.h"
+
+#define KEYSPACE (1 << 20)
+#define SCAN_EVERY 50000 // ops between scans
+#define SCAN_LENGTH 20000
+
+// Replays argv[1] reads (2M by default) of zipfian keys through a cache of
+// argv[2] entries (10000 by default) under every policy, putting each miss,
+// once as is and once with a scan of one-shot keys every SCAN_EVERY reads,
+// and reports the hit rates.
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint64_t next_random(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// Rank drawn from the cumulative zipf(0.99) weights by bisection.
+static int next_zipf(const double *cdf, uint64_t *state)
+{
+    double u = (double)(next_random(state) >> 11) / (double)(1ULL << 53);
+    int lo = 0, hi = KEYSPACE - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (cdf[mid] < u)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void run(const char *name, cache_policy_t policy, const double *cdf,
+                int ops, int entries, bool scans)
+{
+    hashmap_cache_t cache = hashmap_cache_init(policy, entries, 0);
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    int scanned = 0;
+    char key[32];
+
+    double begin = now_seconds();
+    for (int i = 0; i < ops; ++i) {
+        if (scans && i % SCAN_EVERY == 0 && i > 0) {
+            for (int s = 0; s < SCAN_LENGTH; ++s) {
+                sprintf(key, "scan%d", scanned++);
+                if (IS_NIL(hashmap_cache_get(&cache, key)))
+                    hashmap_cache_put(&cache, key, TRUE_VAL);
+            }
+        }
+        sprintf(key, "key%d", next_zipf(cdf, &state));
+        if (IS_NIL(hashmap_cache_get(&cache, key)))
+            hashmap_cache_put(&cache, key, TRUE_VAL);
+    }
+    double elapsed = now_seconds() - begin;
+
+    // Scan reads always miss, so only the zipfian reads are counted.
+    uint64_t misses = cache.misses - (uint64_t)scanned;
+    printf("%-10s %-10s %10.2f %12.2f\n", name, scans ? "zipf+scan" : "zipf",
+           100.0 * (double)cache.hits / (double)(cache.hits + misses),
+           (double)(ops + scanned) / elapsed / 1e6);
+    hashmap_cache_free(&cache);
+}
+
+int main(int argc, char **argv)
+{
+    int ops = argc > 1 ? atoi(argv[1]) : 2000000;
+    int entries = argc > 2 ? atoi(argv[2]) : 10000;
+
+    double *cdf = (double *)malloc(KEYSPACE * sizeof(double));
+    double total = 0;
+    for (int i = 0; i < KEYSPACE; ++i) {
+        total += 1.0 / pow(i + 1, 0.99);
+        cdf[i] = total;
+    }
+    for (int i = 0; i < KEYSPACE; ++i)
+        cdf[i] /= total;
+
+    const char *names[] = {"lru", "clock", "tinylfu", "s3fifo"};
+    cache_policy_t policies[] = {CACHE_LRU, CACHE_CLOCK, CACHE_TINYLFU,
+                                 CACHE_S3FIFO};
+    printf("%-10s %-10s %10s %12s\n", "policy", "workload", "hit %", "Mops/s");
+    for (int scans = 0; scans < 2; ++scans)
+        for (int p = 0; p < 4; ++p)
+            run(names[p], policies[p], cdf, ops, entries, scans);
+
+    free(cdf);
+    return EXIT_SUCCESS;
+}
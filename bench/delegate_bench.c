@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#define _POSIX_C_SOURCE 200809L // clock_gettime, sysconf
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "delegate.h"
+#include "map.h"
+#include "sharded.h"
+
+// Write-heavy counter workload: every thread upserts keys drawn uniformly
+// from a small shared key set, comparing the sharded map (one spinlock per
+// shard) with delegation to per-core owners, both blocking and with up to a
+// full ring of asynchronous requests in flight.
+#define KEYS 4096
+#define OPS_PER_THREAD 200000
+
+typedef enum bench_mode_t {
+    MODE_SHARDED,
+    MODE_DELEGATE_BLOCKING,
+    MODE_DELEGATE_ASYNC,
+} bench_mode_t;
+
+static const char *mode_names[] = {"sharded-spin", "delegate-blocking",
+                                   "delegate-async"};
+
+typedef struct worker_t {
+    bench_mode_t mode;
+    hashmap_sharded_t *sharded;
+    hashmap_delegate_t *delegate;
+    char **keys;
+    uint64_t seed;
+    _Atomic int *ready; // workers registered, main flips it negative to go
+} worker_t;
+
+static inline uint64_t xorshift(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+void *worker(void *arg)
+{
+    worker_t *w = (worker_t *)arg;
+    delegate_client_t *client = NULL;
+    int64_t inflight = 0;
+    if (w->mode != MODE_SHARDED)
+        client = hashmap_delegate_register(w->delegate);
+    atomic_fetch_add(w->ready, 1);
+    while (atomic_load(w->ready) >= 0)
+        sched_yield();
+
+    for (int i = 0; i < OPS_PER_THREAD; ++i) {
+        const char *key = w->keys[xorshift(&w->seed) % KEYS];
+        value_t value = _number_to_value((double)i);
+        delegate_msg_t result;
+        uint64_t ticket;
+        switch (w->mode) {
+        case MODE_SHARDED:
+            hashmap_sharded_upsert(w->sharded, key, value);
+            break;
+        case MODE_DELEGATE_BLOCKING:
+            hashmap_delegate_upsert(w->delegate, client, key, value);
+            break;
+        case MODE_DELEGATE_ASYNC:
+            while (!hashmap_delegate_submit(w->delegate, client,
+                                            DELEGATE_UPSERT, key, value,
+                                            &ticket))
+                while (hashmap_delegate_poll(w->delegate, client, &result))
+                    inflight--;
+            inflight++;
+            break;
+        }
+    }
+
+    if (client != NULL) {
+        // Drain whatever is still in flight before leaving.
+        delegate_msg_t result;
+        while (inflight > 0)
+            inflight -= hashmap_delegate_poll(w->delegate, client, &result);
+        hashmap_delegate_unregister(w->delegate, client);
+    }
+    return NULL;
+}
+
+static double run(bench_mode_t mode, int threads, char **keys)
+{
+    hashmap_sharded_t sharded = {0};
+    hashmap_delegate_t delegate = {0};
+    pthread_t *tids = (pthread_t *)calloc(threads, sizeof(pthread_t));
+    worker_t *workers = (worker_t *)calloc(threads, sizeof(worker_t));
+    _Atomic int ready = 0;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (mode == MODE_SHARDED)
+        sharded = hashmap_sharded_init(cpus > 0 ? (int)cpus : 1, 2 * KEYS,
+                                       0.75, _default_hasher,
+                                       SHARD_LOCK_SPIN);
+    else
+        delegate = hashmap_delegate_init(0, 2 * KEYS, 0.75);
+
+    for (int i = 0; i < threads; ++i) {
+        workers[i].mode = mode;
+        workers[i].sharded = &sharded;
+        workers[i].delegate = &delegate;
+        workers[i].keys = keys;
+        workers[i].seed = 0x9e3779b97f4a7c15ULL * (i + 1);
+        workers[i].ready = &ready;
+        pthread_create(&tids[i], NULL, worker, &workers[i]);
+    }
+    while (atomic_load(&ready) < threads)
+        sched_yield();
+    double begin = now_seconds();
+    atomic_store(&ready, -1);
+    for (int i = 0; i < threads; ++i)
+        pthread_join(tids[i], NULL);
+    double elapsed = now_seconds() - begin;
+
+    if (mode == MODE_SHARDED)
+        hashmap_sharded_free(&sharded);
+    else
+        hashmap_delegate_free(&delegate);
+    free(tids);
+    free(workers);
+    return (double)threads * OPS_PER_THREAD / elapsed / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_threads = argc > 1 ? atoi(argv[1]) : (cpus > 0 ? (int)cpus : 1);
+
+    char **keys = (char **)calloc(KEYS, sizeof(char *));
+    for (int i = 0; i < KEYS; ++i) {
+        keys[i] = (char *)calloc(24, sizeof(char));
+        sprintf(keys[i], "counter%d", i);
+    }
+
+    printf("%-18s %8s %12s\n", "mode", "threads", "Mops/s");
+    for (int mode = MODE_SHARDED; mode <= MODE_DELEGATE_ASYNC; ++mode) {
+        for (int threads = 1; threads <= max_threads; threads *= 2) {
+            double mops = run((bench_mode_t)mode, threads, keys);
+            printf("%-18s %8d %12.2f\n", mode_names[mode], threads, mops);
+        }
+    }
+
+    for (int i = 0; i < KEYS; ++i)
+        free(keys[i]);
+    free(keys);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,577 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#define _DEFAULT_SOURCE // syscall
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "compact.h"
+#include "frozen.h"
+#include "map.h"
+#include "metrics.h"
+#include "sharded.h"
+
+// Workload suite comparing the map engines, printed as one JSON document with
+// each result tagged by its "engine": hashmap_t, hashmap_compact_t,
+// hashmap_frozen_t and hashmap_sharded_t (BENCH_SHARDS shards behind spin
+// locks, driven from one thread, so it shows what routing and locking cost).
+// Every workload runs over a pool of 2 * argv[1] keys (100000 by default) of
+// each length in KEY_LENGTHS, the first half present in the map and the
+// second never added, doing argv[2] operations (500000 by default):
+//
+// - insert:  the present keys into an empty map, growth included
+// - lookup:  gets hitting HIT_RATIOS percent of the time
+// - mixed:   MIXED_WRITE_PCT percent upserts, gets otherwise
+// - churn:   deletes of the oldest key, each followed by an add of a new one
+//
+// Frozen maps are immutable, so they only run the lookups. Compact maps have
+// no separate upsert, their add replaces the value of a present key.
+//
+// Lookups and mixed pick their keys uniformly, zipfian (ZIPF_S) or
+// sequentially through the key set; churn always works oldest first. The
+// access order is drawn up front, and every workload then runs it twice:
+// untimed for "ops_per_sec", and again timing every LATENCY_EVERY-th
+// operation on its own for "latency_ns", whose percentiles therefore include
+// one clock read.
+//
+// On Linux the untimed pass is also measured with perf_event_open hardware
+// counters, user space only, reported per operation under "counters_per_op".
+// A counter the kernel will not open, e.g. under perf_event_paranoid > 2 or
+// in a container, reports null; with none open, or argv[3] is 0, the field
+// itself is null.
+// Comparing key lengths, or lookup hit ratios, shows what chasing each
+// bucket_t's key pointer costs in L1D, LLC and dTLB misses.
+#define MIXED_WRITE_PCT 10
+#define ZIPF_S 0.99
+#define LATENCY_EVERY 7 // odd, so churn samples its deletes and adds alike
+#define BENCH_SHARDS 16
+
+static const int KEY_LENGTHS[] = {8, 32, 256};
+static const int HIT_RATIOS[] = {100, 50, 0};
+
+typedef enum bench_engine_t {
+    ENGINE_MAP,
+    ENGINE_COMPACT,
+    ENGINE_FROZEN,
+    ENGINE_SHARDED,
+    ENGINES,
+} bench_engine_t;
+
+typedef enum bench_work_t {
+    WORK_INSERT,
+    WORK_LOOKUP,
+    WORK_MIXED,
+    WORK_CHURN,
+} bench_work_t;
+
+typedef enum bench_dist_t {
+    DIST_UNIFORM,
+    DIST_ZIPF,
+    DIST_SEQUENTIAL,
+    DIST_COUNT,
+} bench_dist_t;
+
+static const char *ENGINE_NAMES[] = {"map", "compact", "frozen", "sharded"};
+static const char *WORK_NAMES[] = {"insert", "lookup", "mixed", "churn"};
+static const char *DIST_NAMES[] = {"uniform", "zipf", "sequential"};
+static const char *OP_NAMES[] = {"add", "get", "delete", "rehash"};
+
+typedef enum bench_counter_t {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_L1D_MISSES,
+    COUNTER_LLC_MISSES,
+    COUNTER_DTLB_MISSES,
+    COUNTER_BRANCH_MISSES,
+    COUNTERS,
+} bench_counter_t;
+
+static const char *COUNTER_NAMES[] = {"cycles",      "instructions",
+                                      "l1d_misses",  "llc_misses",
+                                      "dtlb_misses", "branch_misses"};
+
+typedef struct bench_t {
+    int n, ops;
+    char **keys; // 2 * n
+    int *order;  // ops indexes into keys
+    double *zipf_cdf;
+    uint64_t rng;
+    bool first; // no result printed yet
+    int counter_fds[COUNTERS]; // -1 where unavailable
+    double counts[COUNTERS];   // over the last loop, -1 if never running
+} bench_t;
+
+// The map under test, only the field for `kind` is in use.
+typedef struct engine_t {
+    bench_engine_t kind;
+    hashmap_t map;
+    hashmap_compact_t compact;
+    hashmap_frozen_t frozen;
+    hashmap_sharded_t sharded;
+} engine_t;
+
+static uint64_t next_random(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static uint64_t splitmix(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// `len` characters: the key's number scrambled into base 62, padded out.
+static char *make_key(uint64_t i, int len)
+{
+    static const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz"
+                                 "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    char *key = (char *)malloc(len + 1);
+    uint64_t x = splitmix(i);
+    for (int c = 0; c < len; ++c) {
+        key[c] = x != 0 ? digits[x % 62] : '.';
+        x /= 62;
+    }
+    key[len] = '\0';
+    return key;
+}
+
+static int next_zipf(bench_t *bench)
+{
+    double u = (double)(next_random(&bench->rng) >> 11) / (double)(1ULL << 53);
+    int lo = 0, hi = bench->n - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (bench->zipf_cdf[mid] < u)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Fills `order` with present keys picked by `dist`, swapping in absent keys
+// for (100 - hit_pct) percent of them.
+static void draw_order(bench_t *bench, bench_dist_t dist, int hit_pct)
+{
+    for (int i = 0; i < bench->ops; ++i) {
+        int k;
+        if (dist == DIST_UNIFORM)
+            k = (int)(next_random(&bench->rng) % (uint64_t)bench->n);
+        else if (dist == DIST_ZIPF)
+            k = next_zipf(bench);
+        else
+            k = i % bench->n;
+        if ((int)(next_random(&bench->rng) % 100) >= hit_pct)
+            k += bench->n;
+        bench->order[i] = k;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Counters                                   //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef __linux__
+#define CACHE_READ_MISS(cache)                                                 \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) |                            \
+     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static void counters_open(bench_t *bench)
+{
+    static const struct {
+        uint32_t type;
+        uint64_t config;
+    } events[COUNTERS] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D)},
+            {PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL)},
+            {PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB)},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    };
+    // Opened one by one rather than as a group, so that one the PMU lacks
+    // does not take the rest down with it; the kernel multiplexes them if
+    // there are too few hardware counters, and counters_stop scales.
+    for (int c = 0; c < COUNTERS; ++c) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[c].type;
+        attr.config = events[c].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+        bench->counter_fds[c] =
+                (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+}
+
+static void counters_start(bench_t *bench)
+{
+    for (int c = 0; c < COUNTERS; ++c) {
+        if (bench->counter_fds[c] < 0)
+            continue;
+        ioctl(bench->counter_fds[c], PERF_EVENT_IOC_RESET, 0);
+        ioctl(bench->counter_fds[c], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+static void counters_stop(bench_t *bench)
+{
+    for (int c = 0; c < COUNTERS; ++c) {
+        bench->counts[c] = -1;
+        if (bench->counter_fds[c] < 0)
+            continue;
+        ioctl(bench->counter_fds[c], PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t read_out[3]; // value, time enabled, time running
+        if (read(bench->counter_fds[c], read_out, sizeof(read_out)) !=
+                    (ssize_t)sizeof(read_out) ||
+            read_out[2] == 0)
+            continue;
+        bench->counts[c] = (double)read_out[0] * (double)read_out[1] /
+                           (double)read_out[2];
+    }
+}
+
+static void counters_close(bench_t *bench)
+{
+    for (int c = 0; c < COUNTERS; ++c)
+        if (bench->counter_fds[c] >= 0)
+            close(bench->counter_fds[c]);
+}
+#else
+static void counters_open(bench_t *bench) { (void)bench; }
+static void counters_start(bench_t *bench) { (void)bench; }
+static void counters_stop(bench_t *bench)
+{
+    for (int c = 0; c < COUNTERS; ++c)
+        bench->counts[c] = -1;
+}
+static void counters_close(bench_t *bench) { (void)bench; }
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Engines                                    //
+////////////////////////////////////////////////////////////////////////////////
+
+static bool engine_runs(bench_engine_t kind, bench_work_t work)
+{
+    return kind != ENGINE_FROZEN || work == WORK_LOOKUP;
+}
+
+static inline void engine_add(engine_t *engine, const char *key,
+                              value_t value)
+{
+    switch (engine->kind) {
+    case ENGINE_MAP:
+        hashmap_add(&engine->map, key, value);
+        break;
+    case ENGINE_COMPACT:
+        hashmap_compact_add(&engine->compact, key, value);
+        break;
+    case ENGINE_SHARDED:
+        hashmap_sharded_add(&engine->sharded, key, value);
+        break;
+    default:
+        break;
+    }
+}
+
+static inline void engine_upsert(engine_t *engine, const char *key,
+                                 value_t value)
+{
+    if (engine->kind == ENGINE_MAP)
+        hashmap_upsert(&engine->map, key, value);
+    else if (engine->kind == ENGINE_SHARDED)
+        hashmap_sharded_upsert(&engine->sharded, key, value);
+    else
+        engine_add(engine, key, value);
+}
+
+static inline void engine_delete(engine_t *engine, const char *key)
+{
+    if (engine->kind == ENGINE_MAP)
+        hashmap_delete(&engine->map, key);
+    else if (engine->kind == ENGINE_COMPACT)
+        hashmap_compact_delete(&engine->compact, key);
+    else if (engine->kind == ENGINE_SHARDED)
+        hashmap_sharded_delete(&engine->sharded, key);
+}
+
+static inline value_t engine_get(engine_t *engine, const char *key)
+{
+    switch (engine->kind) {
+    case ENGINE_MAP:
+        return hashmap_get(&engine->map, key);
+    case ENGINE_COMPACT:
+        return hashmap_compact_get(&engine->compact, key);
+    case ENGINE_FROZEN:
+        return hashmap_frozen_get(&engine->frozen, key);
+    default:
+        return hashmap_sharded_get(&engine->sharded, key);
+    }
+}
+
+static engine_t engine_init(bench_engine_t kind)
+{
+    engine_t engine = {.kind = kind};
+    if (kind == ENGINE_MAP || kind == ENGINE_FROZEN)
+        engine.map = hashmap_init(16, 0.75, _default_hasher);
+    else if (kind == ENGINE_COMPACT)
+        engine.compact = hashmap_compact_init(16);
+    else
+        engine.sharded = hashmap_sharded_init(BENCH_SHARDS, 16 * BENCH_SHARDS,
+                                              0.75, _default_hasher,
+                                              SHARD_LOCK_SPIN);
+    return engine;
+}
+
+// An engine holding the first n keys. Frozen maps are built from a hashmap_t
+// that is freed straight away, the keys belonging to the bench.
+static engine_t engine_filled(bench_t *bench, bench_engine_t kind)
+{
+    engine_t engine = engine_init(kind == ENGINE_FROZEN ? ENGINE_MAP : kind);
+    for (int i = 0; i < bench->n; ++i)
+        engine_add(&engine, bench->keys[i], _number_to_value(i));
+    if (kind == ENGINE_FROZEN) {
+        engine.kind = ENGINE_FROZEN;
+        engine.frozen = hashmap_freeze(&engine.map);
+        hashmap_free(&engine.map);
+    }
+    return engine;
+}
+
+static void engine_free(engine_t *engine)
+{
+    if (engine->kind == ENGINE_MAP)
+        hashmap_free(&engine->map);
+    else if (engine->kind == ENGINE_COMPACT)
+        hashmap_compact_free(&engine->compact);
+    else if (engine->kind == ENGINE_FROZEN)
+        hashmap_frozen_free(&engine->frozen);
+    else
+        hashmap_sharded_free(&engine->sharded);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                  Report                                    //
+////////////////////////////////////////////////////////////////////////////////
+
+static void report(bench_t *bench, bench_engine_t kind, bench_work_t work,
+                   int key_len, const char *dist, int hit_pct, int ops,
+                   double elapsed_ns, hashmap_metrics_t *latency)
+{
+    printf("%s\n    {\"engine\": \"%s\", \"workload\": \"%s\", "
+           "\"key_len\": %d",
+           bench->first ? "" : ",", ENGINE_NAMES[kind], WORK_NAMES[work],
+           key_len);
+    bench->first = false;
+    if (dist != NULL)
+        printf(", \"dist\": \"%s\"", dist);
+    if (hit_pct >= 0)
+        printf(", \"hit_pct\": %d", hit_pct);
+    printf(", \"ops\": %d, \"ops_per_sec\": %.0f, \"latency_ns\": {", ops,
+           (double)ops / (elapsed_ns / 1e9));
+
+    bool first = true;
+    for (int op = 0; op < METRICS_OPS; ++op) {
+        if (hashmap_metrics_percentile(latency, op, 100) == 0)
+            continue;
+        printf("%s\"%s\": {\"p50\": %llu, \"p99\": %llu, \"p999\": %llu}",
+               first ? "" : ", ", OP_NAMES[op],
+               (unsigned long long)hashmap_metrics_percentile(latency, op, 50),
+               (unsigned long long)hashmap_metrics_percentile(latency, op, 99),
+               (unsigned long long)hashmap_metrics_percentile(latency, op,
+                                                              99.9));
+        first = false;
+    }
+
+    int open = 0;
+    for (int c = 0; c < COUNTERS; ++c)
+        open += bench->counter_fds[c] >= 0;
+    if (open == 0) {
+        printf("}, \"counters_per_op\": null}");
+        return;
+    }
+    printf("}, \"counters_per_op\": {");
+    for (int c = 0; c < COUNTERS; ++c) {
+        printf("%s\"%s\": ", c == 0 ? "" : ", ", COUNTER_NAMES[c]);
+        if (bench->counts[c] < 0)
+            printf("null");
+        else
+            printf("%.3f", bench->counts[c] / (double)ops);
+    }
+    printf("}}");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                Workloads                                   //
+////////////////////////////////////////////////////////////////////////////////
+
+// The i-th operation of `work`, returning which kind it was. Churn deletes
+// on even steps and adds on odd ones, keys n..2n-1 taking turns with the
+// present ones so the map keeps n keys.
+static inline metrics_op_t step(bench_t *bench, bench_work_t work,
+                                engine_t *engine, int i)
+{
+    switch (work) {
+    case WORK_INSERT:
+        engine_add(engine, bench->keys[i], _number_to_value(i));
+        return METRICS_ADD;
+    case WORK_LOOKUP:
+        engine_get(engine, bench->keys[bench->order[i]]);
+        return METRICS_GET;
+    case WORK_MIXED:
+        if (i % 100 < MIXED_WRITE_PCT) {
+            engine_upsert(engine, bench->keys[bench->order[i]],
+                          _number_to_value(i));
+            return METRICS_ADD;
+        }
+        engine_get(engine, bench->keys[bench->order[i]]);
+        return METRICS_GET;
+    default:
+        if (i % 2 == 0) {
+            engine_delete(engine, bench->keys[(i / 2) % (2 * bench->n)]);
+            return METRICS_DELETE;
+        }
+        engine_add(engine, bench->keys[(i / 2 + bench->n) % (2 * bench->n)],
+                   TRUE_VAL);
+        return METRICS_ADD;
+    }
+}
+
+// Insert and churn change the map, so each pass starts from a fresh one;
+// lookups and mixed share `loaded`, mixed only ever updating its values.
+static engine_t *pass_engine(bench_t *bench, bench_work_t work,
+                             engine_t *loaded, engine_t *fresh)
+{
+    if (work == WORK_INSERT)
+        *fresh = engine_init(loaded->kind);
+    else if (work == WORK_CHURN)
+        *fresh = engine_filled(bench, loaded->kind);
+    else
+        return loaded;
+    return fresh;
+}
+
+static void run(bench_t *bench, bench_work_t work, engine_t *loaded,
+                int key_len, bench_dist_t dist, int hit_pct)
+{
+    hashmap_metrics_t latency = {0};
+    engine_t fresh;
+    int ops = work == WORK_INSERT ? bench->n : bench->ops;
+    if (!engine_runs(loaded->kind, work))
+        return;
+    if (work == WORK_LOOKUP || work == WORK_MIXED)
+        draw_order(bench, dist, work == WORK_LOOKUP ? hit_pct : 100);
+
+    engine_t *engine = pass_engine(bench, work, loaded, &fresh);
+    counters_start(bench);
+    uint64_t begin = _metrics_now();
+    for (int i = 0; i < ops; ++i)
+        step(bench, work, engine, i);
+    uint64_t elapsed = _metrics_now() - begin;
+    counters_stop(bench);
+    if (engine == &fresh)
+        engine_free(&fresh);
+
+    engine = pass_engine(bench, work, loaded, &fresh);
+    for (int i = 0; i < ops; ++i) {
+        if (i % LATENCY_EVERY != 0) {
+            step(bench, work, engine, i);
+            continue;
+        }
+        uint64_t start = _metrics_now();
+        _metrics_record(&latency, step(bench, work, engine, i), start);
+    }
+    if (engine == &fresh)
+        engine_free(&fresh);
+
+    bool ordered = work == WORK_LOOKUP || work == WORK_MIXED;
+    report(bench, loaded->kind, work, key_len,
+           ordered ? DIST_NAMES[dist] : NULL,
+           work == WORK_LOOKUP ? hit_pct : -1, ops, (double)elapsed,
+           &latency);
+}
+
+int main(int argc, char **argv)
+{
+    bench_t bench = {
+            .n = argc > 1 ? atoi(argv[1]) : 100000,
+            .ops = argc > 2 ? atoi(argv[2]) : 500000,
+            .rng = 0x9e3779b97f4a7c15ULL,
+            .first = true,
+            .counter_fds = {-1, -1, -1, -1, -1, -1},
+    };
+    if (bench.n < 1 || bench.ops < 1)
+        return EXIT_FAILURE;
+    bench.keys = (char **)calloc(2 * (size_t)bench.n, sizeof(char *));
+    bench.order = (int *)calloc(bench.ops, sizeof(int));
+    bench.zipf_cdf = (double *)malloc(bench.n * sizeof(double));
+    if (bench.keys == NULL || bench.order == NULL || bench.zipf_cdf == NULL)
+        return EXIT_FAILURE;
+
+    if (argc <= 3 || atoi(argv[3]) != 0)
+        counters_open(&bench);
+
+    double total = 0;
+    for (int i = 0; i < bench.n; ++i) {
+        total += 1.0 / pow(i + 1, ZIPF_S);
+        bench.zipf_cdf[i] = total;
+    }
+    for (int i = 0; i < bench.n; ++i)
+        bench.zipf_cdf[i] /= total;
+
+    printf("{\"bench\": \"map\", \"keys\": %d, \"ops\": %d, \"results\": [",
+           bench.n, bench.ops);
+    int lengths = (int)(sizeof(KEY_LENGTHS) / sizeof(KEY_LENGTHS[0]));
+    int ratios = (int)(sizeof(HIT_RATIOS) / sizeof(HIT_RATIOS[0]));
+    for (int l = 0; l < lengths; ++l) {
+        int key_len = KEY_LENGTHS[l];
+        for (int i = 0; i < 2 * bench.n; ++i)
+            bench.keys[i] = make_key((uint64_t)i, key_len);
+
+        for (int e = 0; e < ENGINES; ++e) {
+            engine_t engine = engine_filled(&bench, e);
+            run(&bench, WORK_INSERT, &engine, key_len, 0, -1);
+            for (int d = 0; d < DIST_COUNT; ++d)
+                for (int h = 0; h < ratios; ++h)
+                    run(&bench, WORK_LOOKUP, &engine, key_len, d,
+                        HIT_RATIOS[h]);
+            for (int d = 0; d < DIST_COUNT; ++d)
+                run(&bench, WORK_MIXED, &engine, key_len, d, -1);
+            run(&bench, WORK_CHURN, &engine, key_len, 0, -1);
+            engine_free(&engine);
+        }
+
+        for (int i = 0; i < 2 * bench.n; ++i)
+            free(bench.keys[i]);
+    }
+    printf("\n]}\n");
+
+    free(bench.keys);
+    free(bench.order);
+    free(bench.zipf_cdf);
+    counters_close(&bench);
+    return EXIT_SUCCESS;
+}
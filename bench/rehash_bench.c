@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#define _POSIX_C_SOURCE 200809L // clock_gettime, sysconf
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "map.h"
+#include "pool.h"
+
+// Times one full re-housing pass over a table filled to 70%, serially and
+// through pools of 1, 2, 4, ... threads up to the CPU count. The table has
+// 2^argv[1] slots (2^22 by default), argv[2] overrides the thread limit.
+#define FILL 0.7
+#define ROUNDS 3
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Best of ROUNDS passes, each pass re-houses into a fresh array of the same
+// capacity so the table never changes size between rounds.
+static double time_rehash(hashmap_t *map, hashmap_pool_t *pool)
+{
+    double best = 0;
+    for (int r = 0; r < ROUNDS; ++r) {
+        double begin = now_seconds();
+        if (pool != NULL)
+            hashmap_rehash_parallel(map, pool);
+        else
+            hashmap_rehash(map);
+        double elapsed = now_seconds() - begin;
+        if (r == 0 || elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    int bits = argc > 1 ? atoi(argv[1]) : 22;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_threads = argc > 2 ? atoi(argv[2]) : (cpus > 0 ? (int)cpus : 1);
+    int capacity = 1 << bits;
+    int nkeys = (int)(capacity * FILL);
+
+    hashmap_t map = hashmap_init(capacity, 0.75, _default_hasher);
+    char **keys = (char **)calloc(nkeys, sizeof(char *));
+    if (map.buckets.array == NULL || keys == NULL)
+        return EXIT_FAILURE;
+    for (int i = 0; i < nkeys; ++i) {
+        keys[i] = (char *)calloc(24, sizeof(char));
+        sprintf(keys[i], "key%d", i);
+        hashmap_add(&map, keys[i], _number_to_value((double)i));
+    }
+
+    double serial = time_rehash(&map, NULL);
+    printf("%-10s %8s %12s %10s\n", "mode", "threads", "ms", "speedup");
+    printf("%-10s %8d %12.2f %10.2f\n", "serial", 1, serial * 1e3, 1.0);
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        hashmap_pool_t *pool = hashmap_pool_open(threads);
+        double elapsed = time_rehash(&map, pool);
+        printf("%-10s %8d %12.2f %10.2f\n", "parallel", threads, elapsed * 1e3,
+               serial / elapsed);
+        hashmap_pool_close(pool);
+    }
+
+    hashmap_free(&map);
+    for (int i = 0; i < nkeys; ++i)
+        free(keys[i]);
+    free(keys);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,194 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "build.h"
+#include "map.h"
+#include "pool.h"
+#include "xxhash.h"
+
+typedef struct build_job_t {
+    const char **keys;
+    const value_t *values;
+    int n;
+    bucket_t *slots;
+    int capacity;
+    int nregions;
+    uint32_t *homes;        // home bucket of every input key
+    int *counts;            // per worker and region, then scatter offsets
+    int *starts;            // first entry of every region, plus the end
+    build_entry_t *entries; // input grouped by region
+    _Atomic int size;
+    _Atomic int end_ptr;
+} build_job_t;
+
+static inline void _build_share(int64_t total, int worker, int workers,
+                                int *begin, int *end)
+{
+    *begin = (int)(total * worker / workers);
+    *end = (int)(total * (worker + 1) / workers);
+}
+
+static void _build_run(hashmap_pool_t *pool, HM_POOL_TASK task, void *arg)
+{
+    if (pool != NULL)
+        hashmap_pool_run(pool, task, arg);
+    else
+        task(arg, 0, 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Passes                                     //
+////////////////////////////////////////////////////////////////////////////////
+
+static void _build_hash(void *arg, int worker, int workers)
+{
+    build_job_t *job = (build_job_t *)arg;
+    int *counts = job->counts + worker * job->nregions;
+    int begin, end;
+    _build_share(job->n, worker, workers, &begin, &end);
+
+    for (int i = begin; i < end; ++i) {
+        const char *key = job->keys[i];
+        uint32_t home = (uint32_t)(XXH64(key, strlen(key), 0) %
+                                   (uint64_t)job->capacity);
+        job->homes[i] = home;
+        counts[home / BUILD_REGION_SLOTS]++;
+    }
+}
+
+// Each worker's counts have been turned into its offsets within every
+// region's run, so workers scatter without sharing a cursor and every run
+// keeps the input order.
+static void _build_scatter(void *arg, int worker, int workers)
+{
+    build_job_t *job = (build_job_t *)arg;
+    int *offsets = job->counts + worker * job->nregions;
+    int begin, end;
+    _build_share(job->n, worker, workers, &begin, &end);
+
+    for (int i = begin; i < end; ++i) {
+        uint32_t home = job->homes[i];
+        int at = offsets[home / BUILD_REGION_SLOTS]++;
+        build_entry_t *entry = job->entries + at;
+        entry->index = (uint32_t)i;
+        entry->home = home;
+    }
+}
+
+// Claims the first free slot from the entry's home, or overwrites the value
+// when an earlier entry already placed the same key. Equal keys share a home
+// and so a worker, which applies them in input order.
+static void _build_insert(build_job_t *job, build_entry_t *entry, int *added,
+                          int *last)
+{
+    const char *key = job->keys[entry->index];
+    uint64_t capacity = (uint64_t)job->capacity;
+    for (uint64_t idx = entry->home;; idx = (idx + 1) % capacity) {
+        bucket_t *slot = job->slots + idx;
+        const char *stored = __atomic_load_n(&slot->key, __ATOMIC_RELAXED);
+        if (stored == NULL &&
+            __atomic_compare_exchange_n(&slot->key, &stored, key, false,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            (*added)++;
+            if ((int)idx > *last)
+                *last = (int)idx;
+        } else if (stored != key && strcmp(stored, key) != 0) {
+            continue;
+        }
+        slot->value = job->values[entry->index];
+        return;
+    }
+}
+
+static void _build_fill(void *arg, int worker, int workers)
+{
+    build_job_t *job = (build_job_t *)arg;
+    int first, last_region, added = 0, last = -1;
+    _build_share(job->nregions, worker, workers, &first, &last_region);
+
+    for (int i = job->starts[first]; i < job->starts[last_region]; ++i)
+        _build_insert(job, job->entries + i, &added, &last);
+
+    atomic_fetch_add_explicit(&job->size, added, memory_order_relaxed);
+    int seen = atomic_load_explicit(&job->end_ptr, memory_order_relaxed);
+    while (last + 1 > seen &&
+           !atomic_compare_exchange_weak_explicit(&job->end_ptr, &seen,
+                                                  last + 1,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed))
+        ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                Bulk Build                                  //
+////////////////////////////////////////////////////////////////////////////////
+
+hashmap_t hashmap_build(const char **keys, const value_t *values, int n,
+                        double load_factor_pct, hashmap_pool_t *pool)
+{
+    hashmap_t map = {0};
+    int64_t capacity = (int64_t)((double)n / load_factor_pct) + 1;
+    if (capacity < 8)
+        capacity = 8;
+    if (n < 0 || capacity > INT_MAX)
+        return map;
+    map = hashmap_init((int)capacity, load_factor_pct, _default_hasher);
+    if (map.buckets.array == NULL)
+        return map;
+
+    int workers = pool != NULL ? pool->nworkers + 1 : 1;
+    build_job_t job = {
+            .keys = keys,
+            .values = values,
+            .n = n,
+            .slots = map.buckets.array,
+            .capacity = map.buckets.capacity,
+            .nregions = (int)((capacity + BUILD_REGION_SLOTS - 1) /
+                              BUILD_REGION_SLOTS),
+    };
+    job.homes = (uint32_t *)malloc((n + 1) * sizeof(uint32_t));
+    job.entries = (build_entry_t *)malloc((n + 1) * sizeof(build_entry_t));
+    job.counts = (int *)calloc((size_t)workers * job.nregions, sizeof(int));
+    job.starts = (int *)malloc((job.nregions + 1) * sizeof(int));
+    atomic_init(&job.size, 0);
+    atomic_init(&job.end_ptr, 0);
+    if (job.homes == NULL || job.entries == NULL || job.counts == NULL ||
+        job.starts == NULL) {
+        hashmap_free(&map);
+        goto done;
+    }
+
+    _build_run(pool, _build_hash, &job);
+
+    // Lay the runs out region by region, each region's run worker by worker.
+    int offset = 0;
+    for (int r = 0; r < job.nregions; ++r) {
+        job.starts[r] = offset;
+        for (int w = 0; w < workers; ++w) {
+            int count = job.counts[w * job.nregions + r];
+            job.counts[w * job.nregions + r] = offset;
+            offset += count;
+        }
+    }
+    job.starts[job.nregions] = offset;
+
+    _build_run(pool, _build_scatter, &job);
+    _build_run(pool, _build_fill, &job);
+    map.buckets.size = atomic_load(&job.size);
+    map.buckets.end_ptr = atomic_load(&job.end_ptr);
+
+done:
+    free(job.homes);
+    free(job.entries);
+    free(job.counts);
+    free(job.starts);
+    return map;
+}
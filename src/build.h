@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef HASHMAP_BUILD_H_SHARED
+#define HASHMAP_BUILD_H_SHARED
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "map.h"
+#include "pool.h"
+#include "value.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//                              Bulk Build Typing                             //
+////////////////////////////////////////////////////////////////////////////////
+
+// Loads a whole key set in three passes instead of one random bucket write
+// per key:
+//
+// 1. every worker hashes its share of the input, noting each key's home
+//    bucket and counting how many land in each table region,
+// 2. each worker scatters (index, home) pairs into per-region runs, laid out
+//    region after region from the prefix sums of those counts,
+// 3. each worker fills a contiguous slab of regions, so all its writes stay
+//    inside a BUILD_REGION_SLOTS slots (256KiB) window at a time.
+//
+// The table uses `_default_hasher`'s layout, so the result is an ordinary
+// hashmap_t. Probes that run past the end of a region may land in another
+// worker's slab and claim their slot with a CAS, like the parallel rehash.
+#define BUILD_REGION_SLOTS (1 << 14)
+
+typedef struct build_entry_t {
+    uint32_t index; // into the input arrays
+    uint32_t home;  // bucket the key hashes to
+} build_entry_t;
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Bulk Build                                 //
+////////////////////////////////////////////////////////////////////////////////
+
+// Builds a map holding `keys[i] -> values[i]`, sized so the `n` keys stay
+// under `load_factor_pct`. Keys are borrowed, as hashmap_add does, and a key
+// given more than once keeps its last value. Runs on the calling thread alone
+// when `pool` is NULL. Returns a map with a NULL bucket array on failure.
+hashmap_t hashmap_build(const char **keys, const value_t *values, int n,
+                        double load_factor_pct, hashmap_pool_t *pool);
+
+#endif // !HASHMAP_BUILD_H_SHARED
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
@@ -0,0 +1,627 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+#include "map.h"
+#include "xxhash.h"
+
+#define CACHE_MIN_SLOTS 16
+#define CACHE_UNSIZED_WIDTH 4096 // sketch and ghost width with no entry limit
+#define CACHE_WHEEL_MASK (CACHE_WHEEL_SLOTS - 1)
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Entries                                    //
+////////////////////////////////////////////////////////////////////////////////
+
+static void _queue_unlink(hashmap_cache_t *cache, int32_t i)
+{
+    cache_entry_t *entry = cache->entries + i;
+    cache_queue_t *queue = cache->queues + entry->queue;
+    if (entry->prev != CACHE_NONE)
+        cache->entries[entry->prev].next = entry->next;
+    else
+        queue->head = entry->next;
+    if (entry->next != CACHE_NONE)
+        cache->entries[entry->next].prev = entry->prev;
+    else
+        queue->tail = entry->prev;
+    queue->count--;
+}
+
+static void _queue_push(hashmap_cache_t *cache, int id, int32_t i)
+{
+    cache_entry_t *entry = cache->entries + i;
+    cache_queue_t *queue = cache->queues + id;
+    entry->queue = (uint8_t)id;
+    entry->prev = CACHE_NONE;
+    entry->next = queue->head;
+    if (queue->head != CACHE_NONE)
+        cache->entries[queue->head].prev = i;
+    else
+        queue->tail = i;
+    queue->head = i;
+    queue->count++;
+}
+
+static void _queue_move(hashmap_cache_t *cache, int id, int32_t i)
+{
+    _queue_unlink(cache, i);
+    _queue_push(cache, id, i);
+}
+
+// Oldest entry on the queue other than `keep`.
+static int32_t _queue_last(hashmap_cache_t *cache, int id, int32_t keep)
+{
+    int32_t i = cache->queues[id].tail;
+    return i == CACHE_NONE || i != keep ? i : cache->entries[i].prev;
+}
+
+// `pct` percent of the entry limit, or of the current count without one.
+static int _cache_share(hashmap_cache_t *cache, int pct)
+{
+    int limit = cache->max_entries > 0 ? cache->max_entries : cache->count;
+    int share = (int)((int64_t)limit * pct / 100);
+    return share > 0 ? share : 1;
+}
+
+static size_t _cache_bytes(hashmap_cache_t *cache, const char *key,
+                           value_t value)
+{
+    size_t bytes = sizeof(cache_entry_t) + strlen(key) + 1;
+    if (cache->size_fn != NULL)
+        bytes += cache->size_fn(value);
+    return bytes;
+}
+
+// Takes a slot off the free list, or a fresh one from the array.
+static int32_t _cache_slot(hashmap_cache_t *cache)
+{
+    if (cache->free_list != CACHE_NONE) {
+        int32_t i = cache->free_list;
+        cache->free_list = cache->entries[i].next;
+        return i;
+    }
+    if (cache->len == cache->cap) {
+        int32_t cap = cache->cap * 2;
+        cache_entry_t *grown = (cache_entry_t *)realloc(
+                cache->entries, cap * sizeof(cache_entry_t));
+        if (grown == NULL)
+            return CACHE_NONE;
+        cache->entries = grown;
+        cache->cap = cap;
+    }
+    return cache->len++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                            Frequency Sketch                                //
+////////////////////////////////////////////////////////////////////////////////
+
+static inline uint8_t *_sketch_counter(cache_sketch_t *sketch, uint64_t hash,
+                                       int row)
+{
+    uint32_t low = (uint32_t)hash, high = (uint32_t)(hash >> 32) | 1;
+    uint32_t column = (low + (uint32_t)row * high) & sketch->mask;
+    return sketch->counters + (size_t)row * (sketch->mask + 1) + column;
+}
+
+static uint8_t _sketch_estimate(cache_sketch_t *sketch, uint64_t hash)
+{
+    uint8_t least = CACHE_SKETCH_MAX;
+    for (int row = 0; row < CACHE_SKETCH_DEPTH; ++row) {
+        uint8_t count = *_sketch_counter(sketch, hash, row);
+        if (count < least)
+            least = count;
+    }
+    return least;
+}
+
+static void _sketch_increment(cache_sketch_t *sketch, uint64_t hash)
+{
+    for (int row = 0; row < CACHE_SKETCH_DEPTH; ++row) {
+        uint8_t *count = _sketch_counter(sketch, hash, row);
+        if (*count < CACHE_SKETCH_MAX)
+            (*count)++;
+    }
+    if (++sketch->additions < sketch->period)
+        return;
+    size_t counters = (size_t)CACHE_SKETCH_DEPTH * (sketch->mask + 1);
+    for (size_t i = 0; i < counters; ++i)
+        sketch->counters[i] >>= 1;
+    sketch->additions /= 2;
+}
+
+static inline uint32_t _ghost_print(uint64_t hash)
+{
+    return (uint32_t)(hash >> 32) | 1; // never 0, the empty fingerprint
+}
+
+// Whether the ghost table remembers `hash`, forgetting it if so.
+static bool _ghost_take(hashmap_cache_t *cache, uint64_t hash)
+{
+    uint32_t *slot = cache->ghost + (hash & cache->ghost_mask);
+    if (*slot != _ghost_print(hash))
+        return false;
+    *slot = 0;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Policies                                   //
+////////////////////////////////////////////////////////////////////////////////
+
+// Keeps the protected list to its share of the main segment by demoting its
+// oldest entries back to probation.
+static void _tinylfu_balance(hashmap_cache_t *cache)
+{
+    int main = cache->max_entries > 0 ? cache->max_entries : cache->count;
+    main -= _cache_share(cache, CACHE_WINDOW_PCT);
+    int protected = (int)((int64_t)main * CACHE_PROTECTED_PCT / 100);
+    while (cache->queues[CACHE_PROTECTED].count > protected &&
+           cache->queues[CACHE_PROTECTED].count > 1)
+        _queue_move(cache, CACHE_PROBATION,
+                    cache->queues[CACHE_PROTECTED].tail);
+}
+
+static void _cache_touch(hashmap_cache_t *cache, int32_t i)
+{
+    cache_entry_t *entry = cache->entries + i;
+    switch (cache->policy) {
+    case CACHE_CLOCK:
+        entry->referenced = true;
+        break;
+    case CACHE_S3FIFO:
+        if (entry->freq < 3)
+            entry->freq++;
+        break;
+    case CACHE_TINYLFU:
+        _sketch_increment(&cache->sketch, entry->hash);
+        if (entry->queue == CACHE_PROBATION) {
+            _queue_move(cache, CACHE_PROTECTED, i);
+            _tinylfu_balance(cache);
+            break;
+        }
+        // fall through
+    case CACHE_LRU:
+        if (cache->queues[entry->queue].head != i)
+            _queue_move(cache, entry->queue, i);
+        break;
+    }
+}
+
+// Links a new entry into its policy's structures.
+static void _cache_admit(hashmap_cache_t *cache, int32_t i)
+{
+    cache_entry_t *entry = cache->entries + i;
+    entry->referenced = false;
+    entry->freq = 0;
+    switch (cache->policy) {
+    case CACHE_CLOCK:
+        break;
+    case CACHE_S3FIFO:
+        _queue_push(cache,
+                    _ghost_take(cache, entry->hash) ? CACHE_PROBATION
+                                                    : CACHE_WINDOW,
+                    i);
+        break;
+    case CACHE_TINYLFU:
+        _sketch_increment(&cache->sketch, entry->hash);
+        _queue_push(cache, CACHE_WINDOW, i);
+        while (cache->queues[CACHE_WINDOW].count >
+               _cache_share(cache, CACHE_WINDOW_PCT))
+            _queue_move(cache, CACHE_PROBATION,
+                        cache->queues[CACHE_WINDOW].tail);
+        break;
+    case CACHE_LRU:
+        _queue_push(cache, CACHE_WINDOW, i);
+        break;
+    }
+}
+
+// Every pass clears the bits it skips, so this ends within two sweeps.
+static int32_t _clock_victim(hashmap_cache_t *cache, int32_t keep)
+{
+    for (;;) {
+        int32_t i = cache->hand;
+        cache->hand = (cache->hand + 1) % cache->len;
+        cache_entry_t *entry = cache->entries + i;
+        if (entry->key == NULL || i == keep)
+            continue;
+        if (!entry->referenced)
+            return i;
+        entry->referenced = false;
+    }
+}
+
+// The newest probation entry, just out of the window, is the candidate for
+// main: it displaces main's oldest entry only if the sketch has seen it more
+// often, and is evicted itself otherwise.
+static int32_t _tinylfu_victim(hashmap_cache_t *cache, int32_t keep)
+{
+    int32_t candidate = cache->queues[CACHE_PROBATION].head;
+    if (candidate == keep)
+        candidate = CACHE_NONE;
+    int32_t victim = _queue_last(cache, CACHE_PROBATION, keep);
+    if (victim == candidate)
+        victim = _queue_last(cache, CACHE_PROTECTED, keep);
+    if (candidate == CACHE_NONE)
+        return victim != CACHE_NONE ? victim
+                                    : _queue_last(cache, CACHE_WINDOW, keep);
+    if (victim == CACHE_NONE)
+        return candidate;
+
+    uint8_t incoming =
+            _sketch_estimate(&cache->sketch, cache->entries[candidate].hash);
+    uint8_t resident =
+            _sketch_estimate(&cache->sketch, cache->entries[victim].hash);
+    return incoming > resident ? victim : candidate;
+}
+
+// The small queue is drained while over its share (or main is empty): hit
+// entries move to main, the rest are evicted into the ghost table. Main
+// entries with hits left are pushed back round, spending one.
+static int32_t _s3fifo_victim(hashmap_cache_t *cache, int32_t keep)
+{
+    int small = _cache_share(cache, CACHE_SMALL_PCT);
+    for (;;) {
+        int32_t i = _queue_last(cache, CACHE_WINDOW, keep);
+        int32_t j = _queue_last(cache, CACHE_PROBATION, keep);
+        if (i != CACHE_NONE &&
+            (cache->queues[CACHE_WINDOW].count > small || j == CACHE_NONE)) {
+            cache_entry_t *entry = cache->entries + i;
+            if (entry->freq == 0) {
+                cache->ghost[entry->hash & cache->ghost_mask] =
+                        _ghost_print(entry->hash);
+                return i;
+            }
+            entry->freq = 0;
+            _queue_move(cache, CACHE_PROBATION, i);
+        } else if (j == CACHE_NONE || cache->entries[j].freq == 0) {
+            return j;
+        } else {
+            cache->entries[j].freq--;
+            _queue_move(cache, CACHE_PROBATION, j);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                               Timing Wheel                                 //
+////////////////////////////////////////////////////////////////////////////////
+
+// Files the entry at the lowest level whose range covers its expiry, relative
+// to the wheel's cursor. Entries already due go in the slot drained next.
+static void _wheel_insert(hashmap_cache_t *cache, int32_t i)
+{
+    cache_wheel_t *wheel = &cache->wheel;
+    cache_entry_t *entry = cache->entries + i;
+    uint64_t span = 1ULL << (CACHE_WHEEL_BITS * CACHE_WHEEL_LEVELS);
+    uint64_t expires = entry->expires > wheel->cursor ? entry->expires
+                                                      : wheel->cursor;
+    if (expires - wheel->cursor >= span)
+        expires = wheel->cursor + span - 1; // re-filed when it cascades
+    int level = 0;
+    while (level < CACHE_WHEEL_LEVELS - 1 &&
+           expires - wheel->cursor >=
+                   1ULL << (CACHE_WHEEL_BITS * (level + 1)))
+        level++;
+
+    int at = level * CACHE_WHEEL_SLOTS +
+             (int)((expires >> (CACHE_WHEEL_BITS * level)) & CACHE_WHEEL_MASK);
+    entry->timer = (int16_t)at;
+    entry->tprev = CACHE_NONE;
+    entry->tnext = wheel->slots[at];
+    if (entry->tnext != CACHE_NONE)
+        cache->entries[entry->tnext].tprev = i;
+    wheel->slots[at] = i;
+    wheel->counts[level]++;
+}
+
+static void _wheel_unlink(hashmap_cache_t *cache, int32_t i)
+{
+    cache_wheel_t *wheel = &cache->wheel;
+    cache_entry_t *entry = cache->entries + i;
+    if (entry->timer < 0)
+        return;
+    if (entry->tprev != CACHE_NONE)
+        cache->entries[entry->tprev].tnext = entry->tnext;
+    else
+        wheel->slots[entry->timer] = entry->tnext;
+    if (entry->tnext != CACHE_NONE)
+        cache->entries[entry->tnext].tprev = entry->tprev;
+    wheel->counts[entry->timer / CACHE_WHEEL_SLOTS]--;
+    entry->timer = -1;
+}
+
+// Moves the cursor one step towards the clock: a single tick while the
+// bottom level holds entries, otherwise straight to the next boundary of the
+// lowest occupied level. Slots whose turn comes are re-filed, top down, so
+// the bottom slot at the cursor ends up holding everything due now.
+static void _wheel_step(hashmap_cache_t *cache)
+{
+    cache_wheel_t *wheel = &cache->wheel;
+    int empty = 0;
+    while (empty < CACHE_WHEEL_LEVELS && wheel->counts[empty] == 0)
+        empty++;
+    if (empty == CACHE_WHEEL_LEVELS) {
+        wheel->cursor = cache->now;
+        return;
+    }
+    int shift = CACHE_WHEEL_BITS * empty;
+    uint64_t next = ((wheel->cursor >> shift) + 1) << shift;
+    if (next > cache->now) {
+        wheel->cursor = cache->now; // no boundary crossed, nothing falls due
+        return;
+    }
+    wheel->cursor = next;
+
+    for (int level = CACHE_WHEEL_LEVELS - 1; level > 0; --level) {
+        uint64_t low = (1ULL << (CACHE_WHEEL_BITS * level)) - 1;
+        if ((next & low) != 0)
+            continue;
+        int at = level * CACHE_WHEEL_SLOTS +
+                 (int)((next >> (CACHE_WHEEL_BITS * level)) & CACHE_WHEEL_MASK);
+        int32_t i = wheel->slots[at];
+        wheel->slots[at] = CACHE_NONE;
+        while (i != CACHE_NONE) {
+            int32_t following = cache->entries[i].tnext;
+            wheel->counts[level]--;
+            _wheel_insert(cache, i);
+            i = following;
+        }
+    }
+}
+
+static void _cache_remove(hashmap_cache_t *cache, int32_t i)
+{
+    cache_entry_t *entry = cache->entries + i;
+    hashmap_delete(&cache->index, entry->key);
+    if (cache->policy != CACHE_CLOCK)
+        _queue_unlink(cache, i);
+    _wheel_unlink(cache, i);
+    if (cache->on_evict != NULL)
+        cache->on_evict(entry->key, entry->value);
+    free((char *)entry->key);
+    cache->bytes -= entry->bytes;
+    cache->count--;
+
+    entry->key = NULL;
+    entry->next = cache->free_list;
+    cache->free_list = i;
+}
+
+// Picks the entry to evict next, never `keep`. CACHE_NONE once `keep` is the
+// only entry left.
+static int32_t _cache_victim(hashmap_cache_t *cache, int32_t keep)
+{
+    if (cache->count <= 1)
+        return CACHE_NONE;
+    switch (cache->policy) {
+    case CACHE_CLOCK:
+        return _clock_victim(cache, keep);
+    case CACHE_TINYLFU:
+        return _tinylfu_victim(cache, keep);
+    case CACHE_S3FIFO:
+        return _s3fifo_victim(cache, keep);
+    default:
+        return _queue_last(cache, CACHE_WINDOW, keep);
+    }
+}
+
+static inline bool _cache_over(hashmap_cache_t *cache)
+{
+    return (cache->max_entries > 0 && cache->count > cache->max_entries) ||
+           (cache->max_bytes > 0 && cache->bytes > cache->max_bytes);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                Life Cycle                                  //
+////////////////////////////////////////////////////////////////////////////////
+
+hashmap_cache_t hashmap_cache_init(cache_policy_t policy, int max_entries,
+                                   size_t max_bytes)
+{
+    hashmap_cache_t cache = {0};
+    int32_t slots = max_entries > CACHE_MIN_SLOTS ? max_entries + 1
+                                                  : CACHE_MIN_SLOTS;
+    uint32_t width = CACHE_MIN_SLOTS;
+    while (width < (max_entries > 0 ? (uint32_t)max_entries
+                                    : CACHE_UNSIZED_WIDTH))
+        width <<= 1;
+    cache.index = hashmap_init(2 * slots, 0.75, _default_hasher);
+    cache.entries = (cache_entry_t *)calloc(slots, sizeof(cache_entry_t));
+    if (policy == CACHE_TINYLFU) {
+        cache.sketch.counters = (uint8_t *)calloc(
+                (size_t)CACHE_SKETCH_DEPTH * width, sizeof(uint8_t));
+        cache.sketch.mask = width - 1;
+        cache.sketch.period = CACHE_SKETCH_RESET * width;
+    } else if (policy == CACHE_S3FIFO) {
+        cache.ghost = (uint32_t *)calloc(width, sizeof(uint32_t));
+        cache.ghost_mask = width - 1;
+    }
+    if (cache.index.buckets.array == NULL || cache.entries == NULL ||
+        (policy == CACHE_TINYLFU && cache.sketch.counters == NULL) ||
+        (policy == CACHE_S3FIFO && cache.ghost == NULL)) {
+        hashmap_free(&cache.index);
+        free(cache.entries);
+        free(cache.sketch.counters);
+        free(cache.ghost);
+        cache.entries = NULL;
+        return cache;
+    }
+    cache.cap = slots;
+    cache.free_list = CACHE_NONE;
+    for (int q = 0; q < CACHE_QUEUES; ++q)
+        cache.queues[q].head = cache.queues[q].tail = CACHE_NONE;
+    for (int i = 0; i < CACHE_WHEEL_LEVELS * CACHE_WHEEL_SLOTS; ++i)
+        cache.wheel.slots[i] = CACHE_NONE;
+    cache.max_entries = max_entries;
+    cache.max_bytes = max_bytes;
+    cache.policy = policy;
+    return cache;
+}
+
+void hashmap_cache_free(hashmap_cache_t *cache)
+{
+    if (cache->entries == NULL)
+        return;
+    for (int32_t i = 0; i < cache->len; ++i) {
+        cache_entry_t *entry = cache->entries + i;
+        if (entry->key == NULL)
+            continue;
+        if (cache->on_evict != NULL)
+            cache->on_evict(entry->key, entry->value);
+        free((char *)entry->key);
+    }
+    hashmap_free(&cache->index);
+    free(cache->entries);
+    free(cache->sketch.counters);
+    free(cache->ghost);
+    cache->entries = NULL;
+    cache->sketch.counters = NULL;
+    cache->ghost = NULL;
+    cache->len = cache->cap = cache->count = 0;
+    cache->bytes = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                Accessors                                   //
+////////////////////////////////////////////////////////////////////////////////
+
+value_t hashmap_cache_get(hashmap_cache_t *cache, const char *key)
+{
+    value_t slot = hashmap_get(&cache->index, key);
+    if (IS_NIL(slot)) {
+        if (cache->policy == CACHE_TINYLFU)
+            _sketch_increment(&cache->sketch, XXH64(key, strlen(key), 0));
+        cache->misses++;
+        return NIL_VAL;
+    }
+    int32_t i = (int32_t)_value_to_number(&slot);
+    if (cache->entries[i].expires != 0 &&
+        cache->entries[i].expires <= cache->now) {
+        _cache_remove(cache, i);
+        cache->expirations++;
+        cache->misses++;
+        return NIL_VAL;
+    }
+    _cache_touch(cache, i);
+    cache->hits++;
+    return cache->entries[i].value;
+}
+
+static bool _cache_put(hashmap_cache_t *cache, const char *key, value_t value,
+                       uint64_t expires)
+{
+    size_t bytes = _cache_bytes(cache, key, value);
+    if (cache->max_bytes > 0 && bytes > cache->max_bytes)
+        return false;
+
+    int32_t i;
+    value_t slot = hashmap_get(&cache->index, key);
+    if (!IS_NIL(slot)) {
+        i = (int32_t)_value_to_number(&slot);
+        cache_entry_t *entry = cache->entries + i;
+        if (cache->on_evict != NULL && entry->value != value)
+            cache->on_evict(entry->key, entry->value);
+        cache->bytes += bytes - entry->bytes;
+        entry->value = value;
+        entry->bytes = bytes;
+        _wheel_unlink(cache, i);
+        _cache_touch(cache, i);
+    } else {
+        size_t len = strlen(key) + 1;
+        char *owned = (char *)malloc(len);
+        if (owned == NULL)
+            return false;
+        // The slot is taken last, so a failed key copy never strands one.
+        i = _cache_slot(cache);
+        if (i == CACHE_NONE) {
+            free(owned);
+            return false;
+        }
+        memcpy(owned, key, len);
+        if (!hashmap_add(&cache->index, owned, _number_to_value((double)i))) {
+            free(owned);
+            // A fresh slot holds garbage, so mark it empty as a removal does.
+            cache->entries[i].key = NULL;
+            cache->entries[i].next = cache->free_list;
+            cache->free_list = i;
+            return false;
+        }
+        cache_entry_t *entry = cache->entries + i;
+        entry->key = owned;
+        entry->value = value;
+        entry->bytes = bytes;
+        if (cache->policy == CACHE_TINYLFU || cache->policy == CACHE_S3FIFO)
+            entry->hash = XXH64(owned, len - 1, 0);
+        entry->timer = -1;
+        _cache_admit(cache, i);
+        cache->bytes += bytes;
+        cache->count++;
+    }
+    cache->entries[i].expires = expires;
+    if (expires != 0)
+        _wheel_insert(cache, i);
+
+    while (_cache_over(cache)) {
+        int32_t victim = _cache_victim(cache, i);
+        if (victim == CACHE_NONE)
+            break;
+        _cache_remove(cache, victim);
+        cache->evictions++;
+    }
+    return true;
+}
+
+bool hashmap_cache_put(hashmap_cache_t *cache, const char *key, value_t value)
+{
+    return _cache_put(cache, key, value, 0);
+}
+
+bool hashmap_cache_delete(hashmap_cache_t *cache, const char *key)
+{
+    value_t slot = hashmap_get(&cache->index, key);
+    if (IS_NIL(slot))
+        return false;
+    _cache_remove(cache, (int32_t)_value_to_number(&slot));
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Expiry                                     //
+////////////////////////////////////////////////////////////////////////////////
+
+bool hashmap_cache_put_ttl(hashmap_cache_t *cache, const char *key,
+                           value_t value, uint64_t expires)
+{
+    return _cache_put(cache, key, value, expires > 0 ? expires : 1);
+}
+
+int hashmap_cache_expire(hashmap_cache_t *cache, uint64_t now, int budget)
+{
+    cache_wheel_t *wheel = &cache->wheel;
+    int removed = 0;
+    if (now > cache->now)
+        cache->now = now;
+
+    for (;;) {
+        int32_t *due = wheel->slots + (wheel->cursor & CACHE_WHEEL_MASK);
+        while (*due != CACHE_NONE) {
+            if (removed >= budget)
+                return removed;
+            _cache_remove(cache, *due);
+            cache->expirations++;
+            removed++;
+        }
+        if (wheel->cursor >= cache->now)
+            return removed;
+        _wheel_step(cache);
+    }
+}
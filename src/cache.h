@@ -0,0 +1,192 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef HASHMAP_CACHE_H_SHARED
+#define HASHMAP_CACHE_H_SHARED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "map.h"
+#include "value.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//                            Cache HashMap Typing                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// A bounded cache: a hashmap_t index maps every key to its slot in an entry
+// array, and once a put takes the cache over its entry or byte budget the
+// policy picks entries to evict until it fits again.
+//
+// - CACHE_LRU keeps the entries on a doubly linked list threaded through the
+//   array by index, most recently used first, and evicts from the tail.
+// - CACHE_CLOCK gives every entry a reference bit, set on each hit, and
+//   sweeps a hand over the array evicting the first entry whose bit is clear
+//   (clearing the bits it passes), so hits never write to shared links.
+// - CACHE_TINYLFU (W-TinyLFU) puts new entries in a small LRU window
+//   (CACHE_WINDOW_PCT of the entry limit). An entry pushed out of the window
+//   only enters the main segment, an SLRU of probation and protected
+//   (CACHE_PROTECTED_PCT of main) lists, if a count-min sketch of recent
+//   accesses says it is used more often than the main segment's victim.
+// - CACHE_S3FIFO puts new entries in a small FIFO (CACHE_SMALL_PCT of the
+//   entry limit). One leaving it is moved to the main FIFO if it was hit
+//   while there, and otherwise evicted with its hash remembered in a ghost
+//   table; a key found in the ghost table goes straight to main. Main gives
+//   entries with hits another lap, one hit at a time, and hits only bump a
+//   small per-entry counter.
+//
+// Both keep one-hit keys, such as a scan, from flushing out the working set
+// the way LRU does. The sketch and the ghost table are addressed by the
+// key's XXH64, kept with the entry so hits and evictions never rehash it.
+// Without an entry limit the segment shares are taken of the current count.
+//
+// Freed slots are chained by index and reused before the array grows.
+//
+// Entries may also carry an expiry tick. Those are filed in a hierarchical
+// timing wheel of CACHE_WHEEL_LEVELS levels of CACHE_WHEEL_SLOTS slots, each
+// level 64 times coarser than the one below, and re-filed a level down as
+// the wheel turns past their slot. Expiring costs O(1) per expired entry
+// plus one step per occupied tick, never a sweep of the table. The unit of
+// a tick is the caller's (seconds, milliseconds, ...).
+#define CACHE_NONE -1
+#define CACHE_WHEEL_BITS 6
+#define CACHE_WHEEL_SLOTS (1 << CACHE_WHEEL_BITS)
+#define CACHE_WHEEL_LEVELS 4 // ticks beyond 64^4 are re-filed from the top
+#define CACHE_QUEUES 3
+#define CACHE_WINDOW_PCT 1
+#define CACHE_PROTECTED_PCT 80
+#define CACHE_SMALL_PCT 10
+#define CACHE_SKETCH_DEPTH 4
+#define CACHE_SKETCH_MAX 15   // counters saturate like 4-bit ones
+#define CACHE_SKETCH_RESET 10 // halve after 10 increments per counter column
+
+typedef enum cache_policy_t {
+    CACHE_LRU,
+    CACHE_CLOCK,
+    CACHE_TINYLFU,
+    CACHE_S3FIFO,
+} cache_policy_t;
+
+// Lists the entries are threaded on, by policy.
+typedef enum cache_queue_id_t {
+    CACHE_WINDOW = 0, // LRU's only list, TinyLFU's window, S3-FIFO's small
+    CACHE_PROBATION,  // TinyLFU's main probation list, S3-FIFO's main
+    CACHE_PROTECTED,  // TinyLFU's main protected list
+} cache_queue_id_t;
+
+// Called with every key and value the cache drops, whether evicted, deleted,
+// replaced or freed with the cache. The key is the cache's own copy and is
+// freed right after the call.
+typedef void (*HM_CACHE_EVICT)(const char *key, value_t value);
+// Bytes held by a value beyond its value_t, e.g. an OBJ_VAL payload.
+typedef size_t (*HM_CACHE_SIZE)(value_t value);
+
+typedef struct cache_entry_t {
+    const char *key; // owned copy, NULL while the slot is free
+    value_t value;
+    size_t bytes;         // charged against max_bytes
+    uint64_t hash;        // XXH64 of the key
+    uint64_t expires;     // tick the entry expires at, 0 for never
+    int32_t prev, next;   // queue links, `next` also chains free slots
+    int32_t tprev, tnext; // links within the entry's wheel slot
+    int16_t timer;        // wheel slot (level * CACHE_WHEEL_SLOTS + slot)
+    uint8_t queue;        // cache_queue_id_t the entry is on
+    uint8_t freq;         // S3-FIFO hits, up to 3
+    bool referenced;      // CLOCK reference bit
+} cache_entry_t;
+
+typedef struct cache_queue_t {
+    int32_t head, tail; // most recently pushed first
+    int count;
+} cache_queue_t;
+
+// Count-min sketch: CACHE_SKETCH_DEPTH rows of `mask + 1` counters, each
+// row indexed by a different mix of the key's hash. Every counter is halved
+// once `period` increments have been made, so old popularity fades.
+typedef struct cache_sketch_t {
+    uint8_t *counters;
+    uint32_t mask;
+    uint32_t additions, period;
+} cache_sketch_t;
+
+typedef struct cache_wheel_t {
+    int32_t slots[CACHE_WHEEL_LEVELS * CACHE_WHEEL_SLOTS]; // list heads
+    int counts[CACHE_WHEEL_LEVELS]; // entries filed at each level
+    uint64_t cursor; // every tick up to here has been cascaded
+} cache_wheel_t;
+
+typedef struct hashmap_cache_t {
+    hashmap_t index; // key -> entry slot, as a number value
+    cache_entry_t *entries;
+    int32_t len, cap; // slots handed out so far, slots allocated
+    cache_queue_t queues[CACHE_QUEUES];
+    int32_t free_list;
+    int32_t hand; // CLOCK position
+    int count;
+    size_t bytes;
+    int max_entries;  // 0 for no entry limit
+    size_t max_bytes; // 0 for no byte limit
+    cache_policy_t policy;
+    HM_CACHE_EVICT on_evict; // optional
+    HM_CACHE_SIZE size_fn;   // optional
+    cache_sketch_t sketch;   // CACHE_TINYLFU only
+    uint32_t *ghost;         // CACHE_S3FIFO only, hash fingerprints
+    uint32_t ghost_mask;
+    cache_wheel_t wheel;
+    uint64_t now; // latest tick given to hashmap_cache_expire
+    uint64_t hits, misses, evictions, expirations;
+} hashmap_cache_t;
+
+////////////////////////////////////////////////////////////////////////////////
+//                          Cache HashMap Life Cycle                          //
+////////////////////////////////////////////////////////////////////////////////
+
+// With neither `max_entries` nor `max_bytes` set the cache is only bounded
+// by expiry. An entry's bytes are its key, its slot and whatever `size_fn`
+// reports for its value. Returns a cache with NULL entries on failure.
+hashmap_cache_t hashmap_cache_init(cache_policy_t policy, int max_entries,
+                                   size_t max_bytes);
+void hashmap_cache_free(hashmap_cache_t *cache);
+
+////////////////////////////////////////////////////////////////////////////////
+//                           Cache HashMap Accessors                          //
+////////////////////////////////////////////////////////////////////////////////
+
+// Both are O(1): one index probe plus a few link or bit updates. Eviction
+// under CACHE_TINYLFU and CACHE_S3FIFO may move a few entries between lists
+// first, amortised O(1) per put.
+value_t hashmap_cache_get(hashmap_cache_t *cache, const char *key);
+// Inserts or replaces `key` and evicts until the cache fits its budget, the
+// entry just put is never evicted. Fails for an entry over max_bytes alone.
+bool hashmap_cache_put(hashmap_cache_t *cache, const char *key, value_t value);
+bool hashmap_cache_delete(hashmap_cache_t *cache, const char *key);
+
+////////////////////////////////////////////////////////////////////////////////
+//                            Cache HashMap Expiry                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// As hashmap_cache_put, but the entry expires once the cache's clock reaches
+// `expires` (a plain put clears any expiry). The clock only moves through
+// hashmap_cache_expire; gets drop entries that have expired by then even if
+// the wheel has not reached them yet.
+bool hashmap_cache_put_ttl(hashmap_cache_t *cache, const char *key,
+                           value_t value, uint64_t expires);
+// Moves the clock to `now` and removes at most `budget` expired entries,
+// handing each to on_evict. Returns how many were removed; entries left over
+// by the budget are picked up by the next call.
+int hashmap_cache_expire(hashmap_cache_t *cache, uint64_t now, int budget);
+
+#endif // !HASHMAP_CACHE_H_SHARED
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
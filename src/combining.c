@@ -0,0 +1,256 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "combining.h"
+#include "map.h"
+#include "sync.h"
+#include "xxhash.h"
+
+#define COMBINING_MERGE_MASK (COMBINING_MERGE_SLOTS - 1)
+
+////////////////////////////////////////////////////////////////////////////////
+//                                Combiner                                    //
+////////////////////////////////////////////////////////////////////////////////
+
+// Finds the key's slot for this pass, claiming an empty one on a miss. The
+// index has twice as many slots as a pass can hold updates, so never fills.
+static combine_slot_t *_merge_slot(hashmap_combining_t *map, const char *key,
+                                   int *touched)
+{
+    uint64_t hash = XXH64(key, strlen(key), 0);
+    for (uint64_t i = hash;; ++i) {
+        combine_slot_t *slot = map->merge + (i & COMBINING_MERGE_MASK);
+        if (slot->generation != map->generation) {
+            slot->generation = map->generation;
+            slot->key = key;
+            slot->hash = hash;
+            slot->op = 0;
+            map->touched[(*touched)++] = (int)(i & COMBINING_MERGE_MASK);
+            return slot;
+        }
+        if (slot->hash == hash && strcmp(slot->key, key) == 0)
+            return slot;
+    }
+}
+
+// Folds `update` into whatever the pass already holds for its key, so the
+// slot always describes the net effect of the key's updates so far.
+static void _merge(combine_slot_t *slot, combine_update_t *update)
+{
+    if (update->op != COMBINE_INCREMENT || slot->op == 0) {
+        slot->op = update->op;
+        slot->value = update->value;
+        return;
+    }
+    double delta = _value_to_number(&update->value);
+    switch (slot->op) {
+    case COMBINE_INCREMENT:
+        slot->value = _number_to_value(_value_to_number(&slot->value) + delta);
+        break;
+    case COMBINE_UPSERT:
+        if (IS_NUMBER(slot->value))
+            delta += _value_to_number(&slot->value);
+        slot->op = COMBINE_UPSERT;
+        slot->value = _number_to_value(delta);
+        break;
+    case COMBINE_DELETE:
+        slot->op = COMBINE_UPSERT;
+        slot->value = update->value;
+        break;
+    }
+}
+
+static void _apply(hashmap_combining_t *map, combine_slot_t *slot)
+{
+    switch (slot->op) {
+    case COMBINE_INCREMENT: {
+        value_t current = hashmap_get(&map->map, slot->key);
+        double delta = _value_to_number(&slot->value);
+        if (!IS_NIL(current) && IS_NUMBER(current))
+            delta += _value_to_number(&current);
+        hashmap_upsert(&map->map, slot->key, _number_to_value(delta));
+        break;
+    }
+    case COMBINE_UPSERT:
+        hashmap_upsert(&map->map, slot->key, slot->value);
+        break;
+    case COMBINE_DELETE:
+        hashmap_delete(&map->map, slot->key);
+        break;
+    }
+}
+
+// One combining pass, the caller holds the lock. Only the buffers gathered
+// at the start are handed back, one published mid-pass waits for the next.
+static void _combine(hashmap_combining_t *map)
+{
+    int gathered[COMBINING_MAX_THREADS];
+    int touched = 0;
+
+    if (++map->generation == 0) {
+        memset(map->merge, 0, COMBINING_MERGE_SLOTS * sizeof(combine_slot_t));
+        map->generation = 1;
+    }
+    for (int i = 0; i < COMBINING_MAX_THREADS; ++i) {
+        combining_thread_t *thread = map->threads + i;
+        gathered[i] =
+                atomic_load_explicit(&thread->published, memory_order_acquire);
+        for (int j = 0; j < gathered[i]; ++j) {
+            combine_update_t *update = thread->updates + j;
+            _merge(_merge_slot(map, update->key, &touched), update);
+        }
+        map->updates += gathered[i];
+    }
+
+    for (int i = 0; i < touched; ++i)
+        _apply(map, map->merge + map->touched[i]);
+    map->writes += touched;
+
+    for (int i = 0; i < COMBINING_MAX_THREADS; ++i) {
+        if (gathered[i] > 0)
+            atomic_store_explicit(&map->threads[i].published, 0,
+                                  memory_order_release);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                Life Cycle                                  //
+////////////////////////////////////////////////////////////////////////////////
+
+hashmap_combining_t hashmap_combining_init(int capacity,
+                                           double load_factor_pct,
+                                           HM_KEY_HASHER hasher_fn)
+{
+    hashmap_combining_t map = {0};
+    atomic_init(&map.lock, 0);
+
+    map.map = hashmap_init(capacity, load_factor_pct, hasher_fn);
+    if (map.map.buckets.array == NULL)
+        return map;
+    map.map.owns_keys = true;
+
+    map.threads = (combining_thread_t *)aligned_alloc(
+            HM_CACHE_LINE, COMBINING_MAX_THREADS * sizeof(combining_thread_t));
+    map.merge = (combine_slot_t *)calloc(COMBINING_MERGE_SLOTS,
+                                         sizeof(combine_slot_t));
+    map.touched = (int *)malloc(COMBINING_BUFFER * COMBINING_MAX_THREADS *
+                                sizeof(int));
+    if (map.threads == NULL || map.merge == NULL || map.touched == NULL) {
+        free(map.threads);
+        free(map.merge);
+        free(map.touched);
+        hashmap_free(&map.map);
+        map.threads = NULL;
+        return map;
+    }
+    memset(map.threads, 0, COMBINING_MAX_THREADS * sizeof(combining_thread_t));
+    for (int i = 0; i < COMBINING_MAX_THREADS; ++i) {
+        atomic_init(&map.threads[i].published, 0);
+        atomic_init(&map.threads[i].in_use, false);
+    }
+    return map;
+}
+
+void hashmap_combining_free(hashmap_combining_t *map)
+{
+    if (map->threads == NULL)
+        return;
+    hashmap_free(&map->map);
+    free(map->threads);
+    free(map->merge);
+    free(map->touched);
+    map->threads = NULL;
+    map->merge = NULL;
+    map->touched = NULL;
+}
+
+combining_thread_t *hashmap_combining_register(hashmap_combining_t *map)
+{
+    for (int i = 0; i < COMBINING_MAX_THREADS; ++i) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&map->threads[i].in_use, &expected,
+                                           true)) {
+            map->threads[i].len = 0;
+            return map->threads + i;
+        }
+    }
+    return NULL;
+}
+
+void hashmap_combining_unregister(hashmap_combining_t *map,
+                                  combining_thread_t *self)
+{
+    hashmap_combining_flush(map, self);
+    atomic_store_explicit(&self->in_use, false, memory_order_release);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Updates                                    //
+////////////////////////////////////////////////////////////////////////////////
+
+static void _post(hashmap_combining_t *map, combining_thread_t *self,
+                  combine_op_t op, const char *key, value_t value)
+{
+    if (self->len == COMBINING_BUFFER)
+        hashmap_combining_flush(map, self);
+    combine_update_t *update = self->updates + self->len++;
+    update->key = key;
+    update->value = value;
+    update->op = op;
+}
+
+void hashmap_combining_increment(hashmap_combining_t *map,
+                                 combining_thread_t *self, const char *key,
+                                 double delta)
+{
+    _post(map, self, COMBINE_INCREMENT, key, _number_to_value(delta));
+}
+
+void hashmap_combining_upsert(hashmap_combining_t *map,
+                              combining_thread_t *self, const char *key,
+                              value_t value)
+{
+    _post(map, self, COMBINE_UPSERT, key, value);
+}
+
+void hashmap_combining_delete(hashmap_combining_t *map,
+                              combining_thread_t *self, const char *key)
+{
+    _post(map, self, COMBINE_DELETE, key, NIL_VAL);
+}
+
+void hashmap_combining_flush(hashmap_combining_t *map,
+                             combining_thread_t *self)
+{
+    if (self->len == 0)
+        return;
+    atomic_store_explicit(&self->published, self->len, memory_order_release);
+
+    int idle = 0;
+    while (atomic_load_explicit(&self->published, memory_order_acquire) != 0) {
+        if (hm_spin_trylock(&map->lock)) {
+            _combine(map);
+            hm_spin_unlock(&map->lock);
+        } else {
+            hm_backoff(&idle);
+        }
+    }
+    self->len = 0;
+}
+
+value_t hashmap_combining_get(hashmap_combining_t *map,
+                              combining_thread_t *self, const char *key)
+{
+    hashmap_combining_flush(map, self);
+    hm_spin_lock(&map->lock);
+    value_t value = hashmap_get(&map->map, key);
+    hm_spin_unlock(&map->lock);
+    return value;
+}
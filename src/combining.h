@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef HASHMAP_COMBINING_H_SHARED
+#define HASHMAP_COMBINING_H_SHARED
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "map.h"
+#include "sync.h"
+#include "value.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//                          Combining HashMap Typing                          //
+////////////////////////////////////////////////////////////////////////////////
+
+// Flat-combining map for hot, write-heavy keys. Every thread buffers its
+// updates privately and only publishes the buffer when it is full, on an
+// explicit flush, or before a read. Whichever thread takes the lock then acts
+// as the combiner: it gathers every published buffer, merges the updates
+// to each key into one, applies one table write per distinct key and hands
+// the buffers back. Threads that lose the race for the lock just wait for
+// their buffer to come back.
+#define COMBINING_BUFFER 32 // updates a thread buffers before publishing
+#define COMBINING_MAX_THREADS 64
+#define COMBINING_MERGE_SLOTS                                                  \
+    (2 * COMBINING_BUFFER * COMBINING_MAX_THREADS) // power of two
+
+typedef enum combine_op_t {
+    COMBINE_INCREMENT = 1, // add to a number, missing keys count as 0
+    COMBINE_UPSERT,
+    COMBINE_DELETE,
+} combine_op_t;
+
+typedef struct combine_update_t {
+    const char *key;
+    value_t value;
+    uint32_t op;
+} combine_update_t;
+
+typedef struct combining_thread_t {
+    _Alignas(HM_CACHE_LINE) _Atomic int published; // back to 0 once applied
+    int len;
+    _Atomic bool in_use;
+    combine_update_t updates[COMBINING_BUFFER];
+} combining_thread_t;
+
+// Combiner-private index merging the updates of one pass by key. Slots from
+// earlier passes are told apart by their generation instead of clearing.
+typedef struct combine_slot_t {
+    const char *key;
+    uint64_t hash;
+    value_t value;
+    uint32_t op;
+    uint32_t generation;
+} combine_slot_t;
+
+typedef struct hashmap_combining_t {
+    _Alignas(HM_CACHE_LINE) hm_spinlock_t lock;
+    hashmap_t map;
+    combining_thread_t *threads; // COMBINING_MAX_THREADS slots
+    combine_slot_t *merge;       // COMBINING_MERGE_SLOTS slots
+    int *touched;                // merge slots used by the current pass
+    uint32_t generation;
+    uint64_t updates; // updates combined so far
+    uint64_t writes;  // table writes they were merged into
+} hashmap_combining_t;
+
+////////////////////////////////////////////////////////////////////////////////
+//                        Combining HashMap Life Cycle                        //
+////////////////////////////////////////////////////////////////////////////////
+
+// The underlying map copies its keys. Returns a map with NULL threads on
+// failure.
+hashmap_combining_t hashmap_combining_init(int capacity,
+                                           double load_factor_pct,
+                                           HM_KEY_HASHER hasher_fn);
+// Every thread must have flushed or unregistered first.
+void hashmap_combining_free(hashmap_combining_t *map);
+
+// Each updating thread registers once. NULL is returned when all
+// COMBINING_MAX_THREADS slots are taken. Unregistering flushes the buffer.
+combining_thread_t *hashmap_combining_register(hashmap_combining_t *map);
+void hashmap_combining_unregister(hashmap_combining_t *map,
+                                  combining_thread_t *self);
+
+////////////////////////////////////////////////////////////////////////////////
+//                         Combining HashMap Updates                          //
+////////////////////////////////////////////////////////////////////////////////
+
+// Buffered updates, applied in order with this thread's other updates but
+// only visible to other threads once flushed. Keys must stay valid until
+// the next flush returns. Incrementing a value that is not a number
+// replaces it with `delta`.
+void hashmap_combining_increment(hashmap_combining_t *map,
+                                 combining_thread_t *self, const char *key,
+                                 double delta);
+void hashmap_combining_upsert(hashmap_combining_t *map,
+                              combining_thread_t *self, const char *key,
+                              value_t value);
+void hashmap_combining_delete(hashmap_combining_t *map,
+                              combining_thread_t *self, const char *key);
+// Publishes this thread's buffer and returns once it has been applied,
+// combining everyone's pending updates if the lock is free.
+void hashmap_combining_flush(hashmap_combining_t *map,
+                             combining_thread_t *self);
+
+// Flushes this thread's updates first, so it always reads its own writes.
+value_t hashmap_combining_get(hashmap_combining_t *map,
+                              combining_thread_t *self, const char *key);
+
+#endif // !HASHMAP_COMBINING_H_SHARED
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
@@ -0,0 +1,255 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "compact.h"
+#include "vector.h"
+#include "xxhash.h"
+
+// Index slots are signed so the two sentinels are the same bit pattern for
+// every width; all 1s (-1) for an empty slot and -2 for a deleted one.
+#define IX_EMPTY (-1)
+#define IX_DUMMY (-2)
+
+#define COMPACT_MIN_SIZE 8
+
+// Usable entries for a given index size, keeping the index at most 2/3 full so
+// probing always terminates on an empty slot.
+#define COMPACT_USABLE(n) (((n) << 1) / 3)
+
+static int _index_width(int64_t index_size)
+{
+    // A slot must be able to address every entry of the dense array, which
+    // holds at most COMPACT_USABLE(index_size) entries.
+    if (index_size <= 128)
+        return 1;
+    if (index_size <= 32768)
+        return 2;
+    if (index_size <= 2147483648LL)
+        return 4;
+    return 8;
+}
+
+static inline int64_t _index_get(hashmap_compact_t *map, int64_t i)
+{
+    switch (map->index_width) {
+    case 1:
+        return ((int8_t *)map->index)[i];
+    case 2:
+        return ((int16_t *)map->index)[i];
+    case 4:
+        return ((int32_t *)map->index)[i];
+    default:
+        return ((int64_t *)map->index)[i];
+    }
+}
+
+static inline void _index_set(hashmap_compact_t *map, int64_t i, int64_t ix)
+{
+    switch (map->index_width) {
+    case 1:
+        ((int8_t *)map->index)[i] = (int8_t)ix;
+        break;
+    case 2:
+        ((int16_t *)map->index)[i] = (int16_t)ix;
+        break;
+    case 4:
+        ((int32_t *)map->index)[i] = (int32_t)ix;
+        break;
+    default:
+        ((int64_t *)map->index)[i] = ix;
+        break;
+    }
+}
+
+// Probes the index for `key`, returning the entry position when present or -1
+// otherwise. `*slot` is left at the matching index slot, or at the first empty
+// slot of the probe sequence when the key is missing. The probe sequence is
+// the perturbed recurrence CPython uses so every high bit of the hash is
+// eventually mixed into the slot choice.
+static int64_t _compact_lookup(hashmap_compact_t *map, const char *key,
+                               uint64_t hash, int64_t *slot)
+{
+    uint64_t mask = (uint64_t)map->index_size - 1;
+    uint64_t perturb = hash;
+    uint64_t i = hash & mask;
+    for (;;) {
+        int64_t ix = _index_get(map, i);
+        if (ix == IX_EMPTY) {
+            *slot = i;
+            return -1;
+        }
+        if (ix >= 0 && strcmp(map->entries.array[ix].key, key) == 0) {
+            *slot = i;
+            return ix;
+        }
+        perturb >>= 5;
+        i = (i * 5 + perturb + 1) & mask;
+    }
+}
+
+static int64_t _compact_empty_slot(hashmap_compact_t *map, uint64_t hash)
+{
+    uint64_t mask = (uint64_t)map->index_size - 1;
+    uint64_t perturb = hash;
+    uint64_t i = hash & mask;
+    while (_index_get(map, i) != IX_EMPTY) {
+        perturb >>= 5;
+        i = (i * 5 + perturb + 1) & mask;
+    }
+    return i;
+}
+
+hashmap_compact_t hashmap_compact_init(int capacity)
+{
+    hashmap_compact_t map = {0};
+    if (!hashmap_compact_resize(&map, capacity))
+        hashmap_compact_free(&map);
+    return map;
+}
+
+void hashmap_compact_free(hashmap_compact_t *map)
+{
+    vector_free_type(&map->entries, entry_t);
+    free(map->index);
+    map->index = NULL;
+    map->index_size = map->index_width = map->used = 0;
+}
+
+bool hashmap_compact_resize(hashmap_compact_t *map, int capacity)
+{
+    int64_t size = COMPACT_MIN_SIZE;
+    if (capacity < map->used)
+        capacity = map->used;
+    while (COMPACT_USABLE(size) < capacity)
+        size <<= 1;
+    if (size > INT32_MAX)
+        return false;
+
+    int width = _index_width(size);
+    void *index = malloc(size * width);
+    if (index == NULL)
+        return false;
+    // 0xff in every byte reads back as IX_EMPTY for all slot widths
+    memset(index, 0xff, size * width);
+
+    vector_entry_t entries =
+            vector_init_type(entry_t, COMPACT_USABLE(size), 1.0);
+    if (entries.array == NULL) {
+        free(index);
+        return false;
+    }
+
+    hashmap_compact_t next = {
+            .entries = entries,
+            .index = index,
+            .index_size = (int)size,
+            .index_width = width,
+            .used = 0,
+    };
+
+    // Carry live entries over in insertion order, dropping deleted ones so the
+    // dense array is compacted on every resize.
+    for (int i = 0; i < map->entries.end_ptr; ++i) {
+        entry_t curr = map->entries.array[i];
+        if (curr.key == NULL)
+            continue;
+        uint64_t hash = XXH64(curr.key, strlen(curr.key), 0);
+        _index_set(&next, _compact_empty_slot(&next, hash),
+                   next.entries.end_ptr);
+        vector_push_type(&next.entries, entry_t, curr);
+        next.used++;
+    }
+
+    hashmap_compact_free(map);
+    *map = next;
+    return true;
+}
+
+bool hashmap_compact_add(hashmap_compact_t *map, const char *key,
+                         value_t value)
+{
+    int64_t slot, ix;
+    uint64_t hash = XXH64(key, strlen(key), 0);
+
+    ix = _compact_lookup(map, key, hash, &slot);
+    if (ix >= 0) {
+        // Updating an existing key keeps its original insertion position.
+        map->entries.array[ix].value = value;
+        return true;
+    }
+
+    if (map->entries.end_ptr >= map->entries.capacity) {
+        // Grow relative to the live entries so delete-heavy workloads compact
+        // in place rather than doubling. `capacity` counts usable entries,
+        // so half as many again doubles a full index rather than quadrupling.
+        if (!hashmap_compact_resize(map, map->used * 3 / 2))
+            return false;
+        slot = _compact_empty_slot(map, hash);
+    }
+
+    entry_t entry = {
+            .key = key,
+            .value = value,
+    };
+    _index_set(map, slot, map->entries.end_ptr);
+    if (!vector_push_type(&map->entries, entry_t, entry))
+        return false;
+    map->used++;
+    return true;
+}
+
+bool hashmap_compact_delete(hashmap_compact_t *map, const char *key)
+{
+    int64_t slot, ix;
+    uint64_t hash = XXH64(key, strlen(key), 0);
+
+    ix = _compact_lookup(map, key, hash, &slot);
+    if (ix < 0)
+        return false;
+
+    _index_set(map, slot, IX_DUMMY);
+    map->entries.array[ix].key = NULL;
+    map->entries.array[ix].value = NIL_VAL;
+    map->used--;
+    return true;
+}
+
+value_t hashmap_compact_get(hashmap_compact_t *map, const char *key)
+{
+    int64_t slot, ix;
+    uint64_t hash = XXH64(key, strlen(key), 0);
+
+    ix = _compact_lookup(map, key, hash, &slot);
+    if (ix < 0)
+        return NIL_VAL;
+    return map->entries.array[ix].value;
+}
+
+bool hashmap_compact_clear(hashmap_compact_t *map)
+{
+    memset(map->index, 0xff, (size_t)map->index_size * map->index_width);
+    vector_empty_type(&map->entries, entry_t);
+    map->entries.end_ptr = 0;
+    map->used = 0;
+    return true;
+}
+
+bool hashmap_compact_next(hashmap_compact_t *map, int *iter, const char **key,
+                          value_t *value)
+{
+    while (*iter < map->entries.end_ptr) {
+        entry_t *e = map->entries.array + (*iter)++;
+        if (e->key == NULL)
+            continue;
+        *key = e->key;
+        *value = e->value;
+        return true;
+    }
+    return false;
+}
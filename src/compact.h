@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef HASHMAP_COMPACT_H_SHARED
+#define HASHMAP_COMPACT_H_SHARED
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "value.h"
+#include "vector.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//                            Compact HashMap Typing                          //
+////////////////////////////////////////////////////////////////////////////////
+
+// The compact map splits the table in two: a dense, insertion-ordered array of
+// entries and a sparse index array of 1/2/4/8 byte slots that point into it.
+// Deleted entries keep their place (with a NULL key) until the next resize
+// compacts the dense array, so iteration order is always insertion order.
+// Entries hold no hash, so they are no wider than hashmap_t's buckets and the
+// index is the only overhead; keys are rehashed when the index is rebuilt.
+typedef struct entry_t {
+    const char *key;
+    value_t value;
+} entry_t;
+
+typedef struct vector_entry_t vector_entry_t;
+
+#ifndef _DYN_VEC_ENTRY_T
+#define _DYN_VEC_ENTRY_T
+
+VECTOR_DEFINE(entry_t)
+
+#endif /* ifndef _DYN_VEC_ENTRY_T */
+
+typedef struct hashmap_compact_t {
+    vector_entry_t entries;
+    void *index;     // index_size slots of index_width bytes each
+    int index_size;  // always a power of two
+    int index_width; // 1, 2, 4 or 8 bytes - picked from index_size
+    int used;        // live (non-deleted) entries
+} hashmap_compact_t;
+
+////////////////////////////////////////////////////////////////////////////////
+//                         Compact HashMap Life Cycle                         //
+////////////////////////////////////////////////////////////////////////////////
+
+hashmap_compact_t hashmap_compact_init(int capacity);
+void hashmap_compact_free(hashmap_compact_t *map);
+bool hashmap_compact_resize(hashmap_compact_t *map, int capacity);
+
+////////////////////////////////////////////////////////////////////////////////
+//                         Compact HashMap Modifiers                          //
+////////////////////////////////////////////////////////////////////////////////
+
+bool hashmap_compact_add(hashmap_compact_t *map, const char *key,
+                         value_t value);
+bool hashmap_compact_delete(hashmap_compact_t *map, const char *key);
+value_t hashmap_compact_get(hashmap_compact_t *map, const char *key);
+bool hashmap_compact_clear(hashmap_compact_t *map);
+
+// Iterates live entries in insertion order, `*iter` should start at 0 and is
+// advanced past each returned entry; returns false once exhausted.
+bool hashmap_compact_next(hashmap_compact_t *map, int *iter, const char **key,
+                          value_t *value);
+
+#endif // !HASHMAP_COMPACT_H_SHARED
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
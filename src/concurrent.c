@@ -0,0 +1,551 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "concurrent.h"
+#include "ebr.h"
+#include "sync.h"
+#include "xxhash.h"
+
+// Claimed in place of a real key to forward an empty slot of an outgrown
+// table, only its address is ever compared.
+static const char _moved_key[] = "";
+#define MOVED_KEY ((const char *)_moved_key)
+
+typedef enum { FIND_MISS, FIND_HIT, FIND_MOVED } find_result_t;
+typedef enum { CLAIM_NONE, CLAIM_KEY, CLAIM_COPY } claim_t;
+typedef enum { STORE_SET, STORE_IF_EQUAL, STORE_ADD } store_t;
+
+static inline bool _key_eq(const char *stored, const char *key)
+{
+    return stored == key || strcmp(stored, key) == 0;
+}
+
+static ctable_t *_ctable_new(int64_t capacity, double load_factor_pct)
+{
+    size_t bytes = sizeof(ctable_t) + capacity * sizeof(cslot_t);
+    bytes = (bytes + HM_CACHE_LINE - 1) & ~(size_t)(HM_CACHE_LINE - 1);
+    ctable_t *table = (ctable_t *)aligned_alloc(HM_CACHE_LINE, bytes);
+    if (table == NULL)
+        return NULL;
+
+    table->capacity = capacity;
+    table->limit = (int64_t)((double)capacity * load_factor_pct);
+    if (table->limit >= capacity)
+        table->limit = capacity - 1; // always leave an empty slot to probe to
+    atomic_init(&table->used, 0);
+    atomic_init(&table->next, NULL);
+    atomic_init(&table->resizing, false);
+    atomic_init(&table->transfer_index, 0);
+    atomic_init(&table->transferred, 0);
+    for (int64_t i = 0; i < capacity; ++i) {
+        atomic_init(&table->slots[i].key, NULL);
+        atomic_init(&table->slots[i].value, NIL_VAL);
+    }
+    return table;
+}
+
+// Returns the table `table` is being moved into. The first thread to find
+// `table` full takes its `resizing` flag and alone sizes, allocates and
+// installs the next table, every other one waits for it to be published
+// rather than allocating one of its own. The next table only doubles in size
+// when at least half of the claimed keys are still live. NULL when the
+// allocation failed, the flag is then released for a later writer to retry.
+static ctable_t *_cmap_grow(hashmap_concurrent_t *map, ctable_t *table)
+{
+    ctable_t *next = atomic_load_explicit(&table->next, memory_order_acquire);
+    if (next != NULL)
+        return next;
+    bool resizing = false;
+    if (!atomic_compare_exchange_strong_explicit(&table->resizing, &resizing,
+                                                 true, memory_order_acquire,
+                                                 memory_order_relaxed)) {
+        int idle = 0;
+        while ((next = atomic_load_explicit(&table->next,
+                                            memory_order_acquire)) == NULL &&
+               atomic_load_explicit(&table->resizing, memory_order_acquire))
+            hm_backoff(&idle);
+        return next;
+    }
+
+    int64_t live = 0;
+    for (int64_t i = 0; i < table->capacity; ++i) {
+        value_t value = atomic_load_explicit(&table->slots[i].value,
+                                             memory_order_relaxed);
+        live += !IS_NIL(value) && value != CMAP_MOVED_VAL;
+    }
+    int64_t capacity = table->capacity * (live * 2 >= table->limit ? 2 : 1);
+    next = _ctable_new(capacity, map->load_factor_pct);
+    if (next == NULL)
+        atomic_store_explicit(&table->resizing, false, memory_order_release);
+    else
+        atomic_store_explicit(&table->next, next, memory_order_release);
+    return next;
+}
+
+// Claims the empty `slot` for `key` (or a copy of it). Once the table is full,
+// or is already being outgrown, the slot is forwarded instead so `key` can
+// only ever be added to the next table. Returns the key the slot ends up
+// holding, or NULL when the next table or key copy could not be allocated.
+static const char *_ctable_claim(hashmap_concurrent_t *map, ctable_t *table,
+                                 cslot_t *slot, const char *key, claim_t mode)
+{
+    const char *stored = NULL, *claim = key;
+    if (atomic_load_explicit(&table->next, memory_order_acquire) != NULL) {
+        claim = MOVED_KEY;
+    } else if (atomic_fetch_add_explicit(&table->used, 1,
+                                         memory_order_relaxed) >=
+               table->limit) {
+        // Reserve room first so a full table is never over-claimed.
+        atomic_fetch_sub_explicit(&table->used, 1, memory_order_relaxed);
+        if (_cmap_grow(map, table) == NULL)
+            return NULL;
+        claim = MOVED_KEY;
+    } else if (mode == CLAIM_COPY) {
+        size_t len = strlen(key) + 1;
+        char *copy = (char *)malloc(len);
+        if (copy == NULL) {
+            atomic_fetch_sub_explicit(&table->used, 1, memory_order_relaxed);
+            return NULL;
+        }
+        memcpy(copy, key, len);
+        claim = copy;
+    }
+    if (atomic_compare_exchange_strong_explicit(&slot->key, &stored, claim,
+                                                memory_order_acq_rel,
+                                                memory_order_acquire))
+        return claim;
+    // Lost the race for this slot, `stored` now holds the winner.
+    if (claim != MOVED_KEY) {
+        atomic_fetch_sub_explicit(&table->used, 1, memory_order_relaxed);
+        if (claim != key)
+            free((char *)claim); // never published
+    }
+    return stored;
+}
+
+// Finds the slot holding `key`, claiming an empty one for it when `claim` is
+// set. FIND_MOVED means the key, if present at all, lives in `table->next`.
+static find_result_t _ctable_find(hashmap_concurrent_t *map, ctable_t *table,
+                                  const char *key, uint64_t hash,
+                                  claim_t claim, cslot_t **found)
+{
+    uint64_t mask = table->capacity - 1;
+    for (int64_t n = 0; n < table->capacity; ++n) {
+        cslot_t *slot = table->slots + ((hash + n) & mask);
+        const char *stored =
+                atomic_load_explicit(&slot->key, memory_order_acquire);
+        if (stored == NULL) {
+            if (claim == CLAIM_NONE)
+                return FIND_MISS;
+            stored = _ctable_claim(map, table, slot, key, claim);
+            if (stored == NULL)
+                return FIND_MISS;
+        }
+        if (stored == MOVED_KEY)
+            return FIND_MOVED;
+        if (_key_eq(stored, key)) {
+            *found = slot;
+            return FIND_HIT;
+        }
+    }
+    return FIND_MISS;
+}
+
+static ctable_t *_cmap_forward(hashmap_concurrent_t *map, ctable_t *table);
+
+// Works out what a store of kind `kind` writes over `curr`: `value` itself,
+// `value` only while `curr` is still `expected`, or `curr` plus the number
+// in `value` (a missing key counting as 0). False when nothing may be written.
+static inline bool _cmap_desired(store_t kind, value_t curr, value_t value,
+                                 value_t expected, value_t *desired)
+{
+    switch (kind) {
+    case STORE_SET:
+        *desired = value;
+        return true;
+    case STORE_IF_EQUAL:
+        *desired = value;
+        return curr == expected;
+    case STORE_ADD:
+        if (IS_NIL(curr)) {
+            *desired = value;
+            return true;
+        }
+        if (!IS_NUMBER(curr))
+            return false;
+        *desired = _number_to_value(_value_to_number(&curr) +
+                                    _value_to_number(&value));
+        return true;
+    }
+    return false;
+}
+
+// Stores into `key`'s value (claiming a slot for it unless `claim` is
+// CLAIM_NONE) with one CAS, as `_cmap_desired` decides, and hands back the
+// value it found through `prev`. Forwarded slots are followed into newer
+// tables, helping their migration on the way.
+static bool _cmap_store(hashmap_concurrent_t *map, ctable_t *table,
+                        const char *key, uint64_t hash, claim_t claim,
+                        store_t kind, value_t value, value_t expected,
+                        value_t *prev)
+{
+    for (;;) {
+        cslot_t *slot;
+        find_result_t found = _ctable_find(map, table, key, hash, claim, &slot);
+        if (found == FIND_MISS) {
+            *prev = NIL_VAL;
+            return false;
+        }
+        if (found == FIND_HIT) {
+            value_t curr =
+                    atomic_load_explicit(&slot->value, memory_order_acquire);
+            while (curr != CMAP_MOVED_VAL) {
+                value_t desired;
+                if (!_cmap_desired(kind, curr, value, expected, &desired)) {
+                    *prev = curr;
+                    return false;
+                }
+                if (atomic_compare_exchange_weak_explicit(
+                            &slot->value, &curr, desired, memory_order_acq_rel,
+                            memory_order_acquire)) {
+                    *prev = curr;
+                    return true;
+                }
+            }
+        }
+        table = _cmap_forward(map, table);
+    }
+}
+
+// Moves slot `i` of `table` into `next`. The value is copied before the slot
+// is marked as moved, so readers see it in one table or the other, and the
+// copy is redone whenever a writer changes the value in between.
+static void _cmap_transfer_slot(hashmap_concurrent_t *map, ctable_t *table,
+                                ctable_t *next, int64_t i)
+{
+    cslot_t *slot = table->slots + i;
+    const char *key = atomic_load_explicit(&slot->key, memory_order_acquire);
+    while (key == NULL) {
+        if (atomic_compare_exchange_weak_explicit(&slot->key, &key, MOVED_KEY,
+                                                  memory_order_acq_rel,
+                                                  memory_order_acquire))
+            return;
+    }
+    if (key == MOVED_KEY)
+        return;
+
+    uint64_t hash = XXH64(key, strlen(key), 0);
+    bool copied = false;
+    value_t value = atomic_load_explicit(&slot->value, memory_order_acquire);
+    for (;;) {
+        // Deleted keys are left behind, unless an earlier pass copied them.
+        if (!IS_NIL(value) || copied) {
+            value_t prev;
+            // Owned keys are copied again, so that each table only ever
+            // frees the keys it holds.
+            copied = _cmap_store(map, next, key, hash,
+                                 map->owns_keys ? CLAIM_COPY : CLAIM_KEY,
+                                 STORE_SET, value, NIL_VAL, &prev) ||
+                     copied;
+        }
+        if (atomic_compare_exchange_strong_explicit(
+                    &slot->value, &value, CMAP_MOVED_VAL, memory_order_acq_rel,
+                    memory_order_acquire))
+            return;
+    }
+}
+
+// Reclaims an outgrown table along with its copies of the keys.
+static void _ctable_free_owned(void *ptr)
+{
+    ctable_t *table = (ctable_t *)ptr;
+    for (int64_t i = 0; i < table->capacity; ++i) {
+        const char *key = atomic_load(&table->slots[i].key);
+        if (key != NULL && key != MOVED_KEY)
+            free((char *)key);
+    }
+    free(table);
+}
+
+// Swings the map over to the first table, from `table` on, that still has
+// slots left to transfer and retires every table it skipped.
+static void _cmap_promote(hashmap_concurrent_t *map, ctable_t *table)
+{
+    if (atomic_load_explicit(&map->table, memory_order_acquire) != table)
+        return;
+    ctable_t *target = table;
+    while (atomic_load_explicit(&target->transferred, memory_order_acquire) ==
+           target->capacity)
+        target = atomic_load_explicit(&target->next, memory_order_acquire);
+    ctable_t *expected = table;
+    if (!atomic_compare_exchange_strong(&map->table, &expected, target))
+        return;
+
+    ebr_thread_t *self = hashmap_ebr_self(&map->ebr);
+    while (table != target) {
+        ctable_t *next = atomic_load_explicit(&table->next,
+                                              memory_order_acquire);
+        hashmap_ebr_retire(&map->ebr, self, table,
+                           map->owns_keys ? _ctable_free_owned : free);
+        table = next;
+    }
+}
+
+// Claims and moves one stride of `table`, the thread completing the last
+// stride promotes the next table.
+static void _cmap_help(hashmap_concurrent_t *map, ctable_t *table)
+{
+    ctable_t *next = atomic_load_explicit(&table->next, memory_order_acquire);
+    int64_t start = atomic_fetch_add_explicit(
+            &table->transfer_index, CMAP_TRANSFER_STRIDE, memory_order_relaxed);
+    if (start < table->capacity) {
+        int64_t end = start + CMAP_TRANSFER_STRIDE;
+        if (end > table->capacity)
+            end = table->capacity;
+        for (int64_t i = start; i < end; ++i)
+            _cmap_transfer_slot(map, table, next, i);
+        if (atomic_fetch_add_explicit(&table->transferred, end - start,
+                                      memory_order_acq_rel) +
+                    (end - start) <
+            table->capacity)
+            return;
+    } else if (atomic_load_explicit(&table->transferred,
+                                    memory_order_acquire) < table->capacity) {
+        return;
+    }
+    _cmap_promote(map, table);
+}
+
+static ctable_t *_cmap_forward(hashmap_concurrent_t *map, ctable_t *table)
+{
+    _cmap_help(map, table);
+    return atomic_load_explicit(&table->next, memory_order_acquire);
+}
+
+// Pins the map's reclamation epoch for the calling thread, NULL when every
+// thread slot is taken.
+static inline ebr_thread_t *_cmap_enter(hashmap_concurrent_t *map)
+{
+    ebr_thread_t *self = hashmap_ebr_self(&map->ebr);
+    if (self != NULL)
+        hashmap_ebr_enter(&map->ebr, self);
+    return self;
+}
+
+static inline void _cmap_drop(hashmap_concurrent_t *map, ebr_thread_t *self,
+                              value_t value)
+{
+    if (map->free_obj != NULL && IS_OBJ(value))
+        hashmap_ebr_retire(&map->ebr, self, AS_OBJ(value), map->free_obj);
+}
+
+hashmap_concurrent_t hashmap_concurrent_init(int capacity,
+                                             double load_factor_pct)
+{
+    hashmap_concurrent_t map = {0};
+    int64_t size = 8;
+    while (size < capacity)
+        size <<= 1;
+    map.load_factor_pct = load_factor_pct;
+    map.ebr = hashmap_ebr_init();
+    ctable_t *table = map.ebr.threads == NULL
+                              ? NULL
+                              : _ctable_new(size, load_factor_pct);
+    if (table == NULL)
+        hashmap_ebr_free(&map.ebr);
+    atomic_init(&map.table, table);
+    return map;
+}
+
+// Only safe once every other thread is done with the map.
+void hashmap_concurrent_free(hashmap_concurrent_t *map)
+{
+    ctable_t *table = atomic_load(&map->table);
+    while (table != NULL) {
+        for (int64_t i = 0; i < table->capacity; ++i) {
+            const char *key = atomic_load(&table->slots[i].key);
+            value_t value = atomic_load(&table->slots[i].value);
+            if (key == NULL || key == MOVED_KEY)
+                continue;
+            if (map->owns_keys)
+                free((char *)key);
+            if (map->free_obj != NULL && IS_OBJ(value))
+                map->free_obj(AS_OBJ(value));
+        }
+        ctable_t *next = atomic_load(&table->next);
+        free(table);
+        table = next;
+    }
+    atomic_store(&map->table, NULL);
+    hashmap_ebr_free(&map->ebr);
+}
+
+bool hashmap_concurrent_add(hashmap_concurrent_t *map, const char *key,
+                            value_t value)
+{
+    ebr_thread_t *self = _cmap_enter(map);
+    if (self == NULL)
+        return false;
+    ctable_t *table = atomic_load_explicit(&map->table, memory_order_acquire);
+    uint64_t hash = XXH64(key, strlen(key), 0);
+    value_t prev;
+    bool added = _cmap_store(map, table, key, hash,
+                             map->owns_keys ? CLAIM_COPY : CLAIM_KEY,
+                             STORE_SET, value, NIL_VAL, &prev);
+    if (added && prev != value)
+        _cmap_drop(map, self, prev);
+    hashmap_ebr_exit(&map->ebr, self);
+    return added;
+}
+
+bool hashmap_concurrent_upsert(hashmap_concurrent_t *map, const char *key,
+                               value_t value)
+{
+    return hashmap_concurrent_add(map, key, value);
+}
+
+bool hashmap_concurrent_delete(hashmap_concurrent_t *map, const char *key)
+{
+    ebr_thread_t *self = _cmap_enter(map);
+    if (self == NULL)
+        return false;
+    ctable_t *table = atomic_load_explicit(&map->table, memory_order_acquire);
+    uint64_t hash = XXH64(key, strlen(key), 0);
+    value_t prev;
+    // The key keeps its slot, re-adding it later just stores a value again.
+    bool deleted = _cmap_store(map, table, key, hash, CLAIM_NONE, STORE_SET,
+                               NIL_VAL, NIL_VAL, &prev) &&
+                   !IS_NIL(prev);
+    if (deleted)
+        _cmap_drop(map, self, prev);
+    hashmap_ebr_exit(&map->ebr, self);
+    return deleted;
+}
+
+value_t hashmap_concurrent_get(hashmap_concurrent_t *map, const char *key)
+{
+    ebr_thread_t *self = _cmap_enter(map);
+    if (self == NULL)
+        return NIL_VAL;
+    ctable_t *table = atomic_load_explicit(&map->table, memory_order_acquire);
+    uint64_t hash = XXH64(key, strlen(key), 0);
+    value_t value = NIL_VAL;
+    // Readers never help a resize, they just follow forwarded slots.
+    for (;;) {
+        cslot_t *slot;
+        find_result_t found =
+                _ctable_find(map, table, key, hash, CLAIM_NONE, &slot);
+        if (found == FIND_MISS)
+            break;
+        if (found == FIND_HIT) {
+            value = atomic_load_explicit(&slot->value, memory_order_acquire);
+            if (value != CMAP_MOVED_VAL)
+                break;
+            value = NIL_VAL;
+        }
+        table = atomic_load_explicit(&table->next, memory_order_acquire);
+    }
+    hashmap_ebr_exit(&map->ebr, self);
+    return value;
+}
+
+bool hashmap_concurrent_clear(hashmap_concurrent_t *map)
+{
+    ebr_thread_t *self = _cmap_enter(map);
+    if (self == NULL)
+        return false;
+    ctable_t *table = atomic_load_explicit(&map->table, memory_order_acquire);
+    // Finish any move in progress first, until a slot is marked as moved the
+    // next table may hold a stale copy of its value.
+    for (ctable_t *next;
+         (next = atomic_load_explicit(&table->next, memory_order_acquire)) !=
+         NULL;
+         table = next) {
+        while (atomic_load_explicit(&table->transferred,
+                                    memory_order_acquire) < table->capacity) {
+            _cmap_help(map, table);
+            hm_cpu_relax();
+        }
+    }
+
+    for (int64_t i = 0; i < table->capacity; ++i) {
+        cslot_t *slot = table->slots + i;
+        value_t value =
+                atomic_load_explicit(&slot->value, memory_order_acquire);
+        while (value != CMAP_MOVED_VAL && !IS_NIL(value)) {
+            if (atomic_compare_exchange_weak_explicit(
+                        &slot->value, &value, NIL_VAL, memory_order_acq_rel,
+                        memory_order_acquire)) {
+                _cmap_drop(map, self, value);
+                break;
+            }
+        }
+    }
+    hashmap_ebr_exit(&map->ebr, self);
+    return true;
+}
+
+bool hashmap_concurrent_cas(hashmap_concurrent_t *map, const char *key,
+                            value_t expected, value_t desired)
+{
+    ebr_thread_t *self = _cmap_enter(map);
+    if (self == NULL)
+        return false;
+    ctable_t *table = atomic_load_explicit(&map->table, memory_order_acquire);
+    uint64_t hash = XXH64(key, strlen(key), 0);
+    // Only a swap from NIL_VAL can insert, so only it needs to claim a slot.
+    claim_t claim = !IS_NIL(expected) ? CLAIM_NONE
+                    : map->owns_keys  ? CLAIM_COPY
+                                      : CLAIM_KEY;
+    value_t prev;
+    bool swapped = _cmap_store(map, table, key, hash, claim, STORE_IF_EQUAL,
+                               desired, expected, &prev);
+    if (swapped && prev != desired)
+        _cmap_drop(map, self, prev);
+    hashmap_ebr_exit(&map->ebr, self);
+    return swapped;
+}
+
+bool hashmap_concurrent_fetch_add_number(hashmap_concurrent_t *map,
+                                         const char *key, double delta,
+                                         double *prev)
+{
+    ebr_thread_t *self = _cmap_enter(map);
+    if (self == NULL)
+        return false;
+    ctable_t *table = atomic_load_explicit(&map->table, memory_order_acquire);
+    uint64_t hash = XXH64(key, strlen(key), 0);
+    value_t old;
+    bool added = _cmap_store(map, table, key, hash,
+                             map->owns_keys ? CLAIM_COPY : CLAIM_KEY, STORE_ADD,
+                             _number_to_value(delta), NIL_VAL, &old);
+    if (added && prev != NULL)
+        *prev = IS_NIL(old) ? 0 : _value_to_number(&old);
+    hashmap_ebr_exit(&map->ebr, self);
+    return added;
+}
+
+value_t hashmap_concurrent_exchange(hashmap_concurrent_t *map, const char *key,
+                                    value_t value)
+{
+    ebr_thread_t *self = _cmap_enter(map);
+    if (self == NULL)
+        return NIL_VAL;
+    ctable_t *table = atomic_load_explicit(&map->table, memory_order_acquire);
+    uint64_t hash = XXH64(key, strlen(key), 0);
+    claim_t claim = IS_NIL(value)    ? CLAIM_NONE
+                    : map->owns_keys ? CLAIM_COPY
+                                     : CLAIM_KEY;
+    value_t prev;
+    // The replaced value goes back to the caller, so it is never dropped.
+    _cmap_store(map, table, key, hash, claim, STORE_SET, value, NIL_VAL, &prev);
+    hashmap_ebr_exit(&map->ebr, self);
+    return prev;
+}
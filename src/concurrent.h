@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef HASHMAP_CONCURRENT_H_SHARED
+#define HASHMAP_CONCURRENT_H_SHARED
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ebr.h"
+#include "sync.h"
+#include "value.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//                          Concurrent HashMap Typing                         //
+////////////////////////////////////////////////////////////////////////////////
+
+// Lock-free open-addressing map in the style of Cliff Click's non-blocking
+// hash map. A slot is two independently CAS-able words: the key pointer, which
+// is claimed once with a CAS from NULL and never changes again, and the
+// value_t, which is updated with atomic stores/CAS. Every value starts out as
+// NIL_VAL and a delete simply stores NIL_VAL back, so readers can never see a
+// half-inserted entry and reads are wait-free (at most one pass of the table).
+//
+// Growth follows Java's ConcurrentHashMap transfer: once a table fills up a
+// twice as large `next` table is allocated (exactly once, by the one thread
+// that wins the `resizing` flag, the others waiting for it) and every
+// writer that touches the map claims a stride of old slots and moves them.
+// A moved slot is forwarded by storing CMAP_MOVED_VAL into its value, an
+// empty one by claiming its key with a marker, and any thread that meets
+// either simply carries on in `next`. The last stride to finish promotes
+// `next` to be the map's table. Tables that are mostly deleted keys are moved
+// into one of the same size instead, so churn alone never grows the map.
+//
+// Outgrown tables (with their owned keys) and replaced objects are reclaimed
+// through the map's epoch-based reclamation domain, which every operation
+// pins for its duration.
+#define CMAP_TRANSFER_STRIDE 256
+#define CMAP_MOVED_VAL ((value_t)(uint64_t)(QNAN | 4)) // no other tag uses 100
+
+typedef struct cslot_t {
+    _Atomic(const char *) key;
+    _Atomic(value_t) value;
+} cslot_t;
+
+typedef struct ctable_t {
+    int64_t capacity; // power of two
+    int64_t limit;    // claimed keys allowed before the table grows
+    _Alignas(HM_CACHE_LINE) _Atomic int64_t used; // claimed key slots
+    _Alignas(HM_CACHE_LINE) _Atomic(struct ctable_t *) next; // resize target
+    _Atomic bool resizing; // held by the one thread allocating `next`
+    _Atomic int64_t transfer_index; // next stride of slots to be claimed
+    _Atomic int64_t transferred;    // slots whose move has completed
+    _Alignas(HM_CACHE_LINE) cslot_t slots[];
+} ctable_t;
+
+typedef struct hashmap_concurrent_t {
+    _Atomic(ctable_t *) table;
+    hashmap_ebr_t ebr;
+    bool owns_keys;       // every table holds, and frees, its own key copies
+    HM_EBR_FREE free_obj; // when set, OBJ_VAL values the map drops are freed
+    double load_factor_pct;
+} hashmap_concurrent_t;
+
+////////////////////////////////////////////////////////////////////////////////
+//                       Concurrent HashMap Life Cycle                        //
+////////////////////////////////////////////////////////////////////////////////
+
+// The capacity is rounded up to a power of two and the table is replaced
+// whenever `capacity * load_factor_pct` keys have been claimed; deleted keys
+// are dropped at that point. Unless `owns_keys` is set keys are borrowed and
+// must outlive the map. The map must not be moved once it has been used, and
+// at most EBR_MAX_THREADS threads may use it at a time (operations on any
+// further threads fail).
+hashmap_concurrent_t hashmap_concurrent_init(int capacity,
+                                             double load_factor_pct);
+void hashmap_concurrent_free(hashmap_concurrent_t *map);
+
+////////////////////////////////////////////////////////////////////////////////
+//                       Concurrent HashMap Modifiers                         //
+////////////////////////////////////////////////////////////////////////////////
+
+bool hashmap_concurrent_add(hashmap_concurrent_t *map, const char *key,
+                            value_t value);
+bool hashmap_concurrent_upsert(hashmap_concurrent_t *map, const char *key,
+                               value_t value);
+bool hashmap_concurrent_delete(hashmap_concurrent_t *map, const char *key);
+value_t hashmap_concurrent_get(hashmap_concurrent_t *map, const char *key);
+bool hashmap_concurrent_clear(hashmap_concurrent_t *map);
+
+////////////////////////////////////////////////////////////////////////////////
+//                     Concurrent HashMap Atomic Updates                      //
+////////////////////////////////////////////////////////////////////////////////
+
+// Each of these is one probe and one CAS on the slot's value word, retried
+// only when another writer got in first. NIL_VAL stands for a missing key
+// throughout.
+
+// Replaces the value only while it still equals `expected`, so a NIL_VAL
+// `expected` inserts and a NIL_VAL `desired` deletes. The replaced value is
+// dropped like an upsert's.
+bool hashmap_concurrent_cas(hashmap_concurrent_t *map, const char *key,
+                            value_t expected, value_t desired);
+// Adds `delta` to a number value, a missing key counting as 0, and stores
+// the number it held through `prev` (which may be NULL). Fails, leaving the
+// value alone, if it holds anything other than a number.
+bool hashmap_concurrent_fetch_add_number(hashmap_concurrent_t *map,
+                                         const char *key, double delta,
+                                         double *prev);
+// Stores `value` and returns the one it replaced, whose ownership passes
+// back to the caller: it is not handed to the map's free_obj.
+value_t hashmap_concurrent_exchange(hashmap_concurrent_t *map, const char *key,
+                                    value_t value);
+
+#endif // !HASHMAP_CONCURRENT_H_SHARED
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
@@ -0,0 +1,455 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // pthread_setaffinity_np
+#endif
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "delegate.h"
+#include "map.h"
+#include "sync.h"
+#include "xxhash.h"
+
+#define DELEGATE_RING_MASK (DELEGATE_RING_SIZE - 1)
+
+////////////////////////////////////////////////////////////////////////////////
+//                               SPSC Rings                                   //
+////////////////////////////////////////////////////////////////////////////////
+
+// Producer side: free slots, only re-reading the consumer's head once the
+// cached copy says the ring is full.
+static inline uint32_t _ring_space(delegate_ring_t *ring)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail - ring->head_cache == DELEGATE_RING_SIZE)
+        ring->head_cache =
+                atomic_load_explicit(&ring->head, memory_order_acquire);
+    return DELEGATE_RING_SIZE - (tail - ring->head_cache);
+}
+
+// Consumer side: filled slots, the mirror image of _ring_space.
+static inline uint32_t _ring_ready(delegate_ring_t *ring)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (ring->tail_cache == head)
+        ring->tail_cache =
+                atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return ring->tail_cache - head;
+}
+
+static inline delegate_msg_t *_ring_at(delegate_ring_t *ring, uint32_t index)
+{
+    return ring->slots + (index & DELEGATE_RING_MASK);
+}
+
+static void _ring_init(delegate_ring_t *ring)
+{
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->head, 0);
+    ring->head_cache = ring->tail_cache = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Owners                                     //
+////////////////////////////////////////////////////////////////////////////////
+
+static inline int _owner_for(hashmap_delegate_t *map, const char *key)
+{
+    uint64_t hash = XXH64(key, strlen(key), 0);
+    return (int)(((hash >> 32) * (uint64_t)map->nowners) >> 32);
+}
+
+static void _owner_apply(delegate_owner_t *owner, delegate_msg_t *msg)
+{
+    switch (msg->op) {
+    case DELEGATE_ADD:
+        msg->ok = hashmap_add(&owner->map, msg->key, msg->value);
+        break;
+    case DELEGATE_UPSERT:
+        msg->ok = hashmap_upsert(&owner->map, msg->key, msg->value);
+        break;
+    case DELEGATE_DELETE:
+        msg->ok = hashmap_delete(&owner->map, msg->key);
+        break;
+    case DELEGATE_GET:
+        msg->value = hashmap_get(&owner->map, msg->key);
+        msg->ok = !IS_NIL(msg->value);
+        break;
+    default:
+        msg->ok = false;
+    }
+    msg->key = NULL; // the client may reuse it as soon as it sees the result
+}
+
+// Serves one batch from `requests` into `responses`, both rings' indices are
+// published once for the whole batch.
+static int _owner_serve(delegate_owner_t *owner, delegate_ring_t *requests,
+                        delegate_ring_t *responses)
+{
+    uint32_t n = _ring_ready(requests);
+    if (n == 0)
+        return 0;
+    uint32_t space = _ring_space(responses);
+    if (n > space)
+        n = space;
+    if (n > DELEGATE_BATCH)
+        n = DELEGATE_BATCH;
+
+    uint32_t head = atomic_load_explicit(&requests->head, memory_order_relaxed);
+    uint32_t tail =
+            atomic_load_explicit(&responses->tail, memory_order_relaxed);
+    for (uint32_t i = 0; i < n; ++i) {
+        delegate_msg_t *msg = _ring_at(responses, tail + i);
+        *msg = *_ring_at(requests, head + i);
+        _owner_apply(owner, msg);
+    }
+    atomic_store_explicit(&requests->head, head + n, memory_order_release);
+    atomic_store_explicit(&responses->tail, tail + n, memory_order_release);
+    return (int)n;
+}
+
+static int _owner_poll(delegate_owner_t *owner)
+{
+    int served = 0;
+    for (int i = 0; i < DELEGATE_MAX_CLIENTS; ++i) {
+        delegate_client_t *client = owner->clients + i;
+        if (!atomic_load_explicit(&client->active, memory_order_acquire))
+            continue;
+        served += _owner_serve(owner, client->requests + owner->id,
+                               client->responses + owner->id);
+    }
+    return served;
+}
+
+// Sleeps until a client submits. `parked` is raised before the rings are
+// checked one last time and clients check it after publishing a request,
+// both behind a full fence, so either the owner sees the request or the
+// client sees the flag and wakes it.
+static void _owner_park(delegate_owner_t *owner)
+{
+    atomic_store(&owner->parked, true);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (_owner_poll(owner) > 0) {
+        atomic_store(&owner->parked, false);
+        return;
+    }
+    pthread_mutex_lock(&owner->park_lock);
+    while (atomic_load(&owner->parked) &&
+           !atomic_load_explicit(&owner->stop, memory_order_acquire))
+        pthread_cond_wait(&owner->wake, &owner->park_lock);
+    pthread_mutex_unlock(&owner->park_lock);
+}
+
+static void _owner_wake(delegate_owner_t *owner)
+{
+    pthread_mutex_lock(&owner->park_lock);
+    atomic_store(&owner->parked, false);
+    pthread_cond_signal(&owner->wake);
+    pthread_mutex_unlock(&owner->park_lock);
+}
+
+static void *_owner_run(void *arg)
+{
+    delegate_owner_t *owner = (delegate_owner_t *)arg;
+    int idle = 0, empty = 0;
+
+    while (!atomic_load_explicit(&owner->stop, memory_order_acquire)) {
+        if (_owner_poll(owner) > 0) {
+            idle = empty = 0;
+        } else if (++empty < DELEGATE_PARK_ROUNDS) {
+            hm_backoff(&idle);
+        } else {
+            _owner_park(owner);
+            idle = empty = 0;
+        }
+    }
+    return NULL;
+}
+
+static void _owner_pin(delegate_owner_t *owner)
+{
+#if defined(__linux__)
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus <= 0)
+        return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(owner->id % cpus, &set);
+    pthread_setaffinity_np(owner->thread, sizeof(cpu_set_t), &set);
+#else
+    (void)owner; // no portable affinity API, leave it to the scheduler
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                Life Cycle                                  //
+////////////////////////////////////////////////////////////////////////////////
+
+hashmap_delegate_t hashmap_delegate_init(int owners, int capacity,
+                                         double load_factor_pct)
+{
+    hashmap_delegate_t map = {0};
+    if (owners <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        owners = cpus > 0 ? (int)cpus : 1;
+    }
+    int per_owner = capacity / owners < 8 ? 8 : capacity / owners;
+
+    map.clients = (delegate_client_t *)calloc(DELEGATE_MAX_CLIENTS,
+                                              sizeof(delegate_client_t));
+    map.owners = (delegate_owner_t *)aligned_alloc(
+            HM_CACHE_LINE, owners * sizeof(delegate_owner_t));
+    if (map.clients == NULL || map.owners == NULL) {
+        free(map.clients);
+        free(map.owners);
+        map.clients = NULL;
+        map.owners = NULL;
+        return map;
+    }
+    for (int i = 0; i < DELEGATE_MAX_CLIENTS; ++i) {
+        atomic_init(&map.clients[i].in_use, false);
+        atomic_init(&map.clients[i].active, false);
+    }
+    memset(map.owners, 0, owners * sizeof(delegate_owner_t));
+
+    for (int i = 0; i < owners; ++i) {
+        delegate_owner_t *owner = map.owners + i;
+        owner->map = hashmap_init(per_owner, load_factor_pct, _default_hasher);
+        owner->map.owns_keys = true;
+        owner->id = i;
+        owner->clients = map.clients;
+        atomic_init(&owner->stop, false);
+        atomic_init(&owner->parked, false);
+        pthread_mutex_init(&owner->park_lock, NULL);
+        pthread_cond_init(&owner->wake, NULL);
+        if (owner->map.buckets.array == NULL ||
+            pthread_create(&owner->thread, NULL, _owner_run, owner) != 0) {
+            hashmap_free(&owner->map);
+            pthread_mutex_destroy(&owner->park_lock);
+            pthread_cond_destroy(&owner->wake);
+            hashmap_delegate_free(&map);
+            return map;
+        }
+        map.nowners = i + 1;
+        _owner_pin(owner);
+    }
+    return map;
+}
+
+void hashmap_delegate_free(hashmap_delegate_t *map)
+{
+    for (int i = 0; i < map->nowners; ++i) {
+        atomic_store(&map->owners[i].stop, true);
+        _owner_wake(map->owners + i);
+    }
+    for (int i = 0; i < map->nowners; ++i) {
+        pthread_join(map->owners[i].thread, NULL);
+        hashmap_free(&map->owners[i].map);
+        pthread_mutex_destroy(&map->owners[i].park_lock);
+        pthread_cond_destroy(&map->owners[i].wake);
+    }
+    for (int i = 0; map->clients != NULL && i < DELEGATE_MAX_CLIENTS; ++i) {
+        free(map->clients[i].requests);
+        free(map->clients[i].responses);
+        free(map->clients[i].stash);
+    }
+    free(map->owners);
+    free(map->clients);
+    map->owners = NULL;
+    map->clients = NULL;
+    map->nowners = 0;
+}
+
+delegate_client_t *hashmap_delegate_register(hashmap_delegate_t *map)
+{
+    for (int i = 0; i < DELEGATE_MAX_CLIENTS; ++i) {
+        delegate_client_t *client = map->clients + i;
+        bool expected = false;
+        if (atomic_load(&client->in_use) ||
+            !atomic_compare_exchange_strong(&client->in_use, &expected, true))
+            continue;
+
+        // Rings survive unregistering, a slot is only set up on first use.
+        if (client->requests == NULL) {
+            size_t bytes = map->nowners * sizeof(delegate_ring_t);
+            client->stash_cap = 2 * DELEGATE_RING_SIZE * map->nowners;
+            client->requests =
+                    (delegate_ring_t *)aligned_alloc(HM_CACHE_LINE, bytes);
+            client->responses =
+                    (delegate_ring_t *)aligned_alloc(HM_CACHE_LINE, bytes);
+            client->stash = (delegate_msg_t *)calloc(client->stash_cap,
+                                                     sizeof(delegate_msg_t));
+            if (client->requests == NULL || client->responses == NULL ||
+                client->stash == NULL) {
+                free(client->requests);
+                free(client->responses);
+                free(client->stash);
+                client->requests = client->responses = NULL;
+                client->stash = NULL;
+                atomic_store(&client->in_use, false);
+                return NULL;
+            }
+            for (int j = 0; j < map->nowners; ++j) {
+                _ring_init(client->requests + j);
+                _ring_init(client->responses + j);
+            }
+        }
+        client->stash_head = client->stash_len = client->unpolled = 0;
+        client->next_owner = 0;
+        client->next_ticket = 1;
+        atomic_store_explicit(&client->active, true, memory_order_release);
+        return client;
+    }
+    return NULL;
+}
+
+void hashmap_delegate_unregister(hashmap_delegate_t *map,
+                                 delegate_client_t *client)
+{
+    atomic_store_explicit(&client->active, false, memory_order_release);
+    atomic_store_explicit(&client->in_use, false, memory_order_release);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                Requests                                    //
+////////////////////////////////////////////////////////////////////////////////
+
+static bool _client_submit(hashmap_delegate_t *map, delegate_client_t *client,
+                           int owner, delegate_op_t op, const char *key,
+                           value_t value, uint64_t *ticket)
+{
+    delegate_ring_t *ring = client->requests + owner;
+    if (_ring_space(ring) == 0)
+        return false;
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    delegate_msg_t *msg = _ring_at(ring, tail);
+    msg->ticket = client->next_ticket++;
+    msg->key = key;
+    msg->value = value;
+    msg->op = op;
+    msg->ok = false;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    *ticket = msg->ticket;
+
+    // Pairs with the fence in _owner_park.
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&map->owners[owner].parked, memory_order_relaxed))
+        _owner_wake(map->owners + owner);
+    return true;
+}
+
+static bool _client_take(delegate_client_t *client, int owner,
+                         delegate_msg_t *result)
+{
+    delegate_ring_t *ring = client->responses + owner;
+    if (_ring_ready(ring) == 0)
+        return false;
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    *result = *_ring_at(ring, head);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
+
+static void _client_stash(delegate_client_t *client, delegate_msg_t *result)
+{
+    int at = (client->stash_head + client->stash_len) % client->stash_cap;
+    client->stash[at] = *result;
+    client->stash_len++;
+}
+
+// Submits a request and waits for its own result, stashing any results of
+// asynchronous requests to the same owner that arrive first. Those are
+// bounded by `unpolled`, which submit keeps within the stash's capacity.
+static delegate_msg_t _client_call(hashmap_delegate_t *map,
+                                   delegate_client_t *client, delegate_op_t op,
+                                   const char *key, value_t value)
+{
+    int owner = _owner_for(map, key);
+    delegate_msg_t result = {0};
+    uint64_t ticket;
+    int idle = 0;
+
+    while (!_client_submit(map, client, owner, op, key, value, &ticket)) {
+        if (_client_take(client, owner, &result))
+            _client_stash(client, &result);
+        else
+            hm_backoff(&idle);
+    }
+    for (;;) {
+        if (!_client_take(client, owner, &result)) {
+            hm_backoff(&idle);
+            continue;
+        }
+        if (result.ticket == ticket)
+            return result;
+        _client_stash(client, &result);
+    }
+}
+
+bool hashmap_delegate_submit(hashmap_delegate_t *map, delegate_client_t *client,
+                             delegate_op_t op, const char *key, value_t value,
+                             uint64_t *ticket)
+{
+    if (client->unpolled >= client->stash_cap ||
+        !_client_submit(map, client, _owner_for(map, key), op, key, value,
+                        ticket))
+        return false;
+    client->unpolled++;
+    return true;
+}
+
+bool hashmap_delegate_poll(hashmap_delegate_t *map, delegate_client_t *client,
+                           delegate_msg_t *result)
+{
+    if (client->stash_len > 0) {
+        *result = client->stash[client->stash_head];
+        client->stash_head = (client->stash_head + 1) % client->stash_cap;
+        client->stash_len--;
+        client->unpolled--;
+        return true;
+    }
+    for (int i = 0; i < map->nowners; ++i) {
+        int owner = (client->next_owner + i) % map->nowners;
+        if (_client_take(client, owner, result)) {
+            client->next_owner = owner;
+            client->unpolled--;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool hashmap_delegate_add(hashmap_delegate_t *map, delegate_client_t *client,
+                          const char *key, value_t value)
+{
+    return _client_call(map, client, DELEGATE_ADD, key, value).ok;
+}
+
+bool hashmap_delegate_upsert(hashmap_delegate_t *map,
+                             delegate_client_t *client, const char *key,
+                             value_t value)
+{
+    return _client_call(map, client, DELEGATE_UPSERT, key, value).ok;
+}
+
+bool hashmap_delegate_delete(hashmap_delegate_t *map,
+                             delegate_client_t *client, const char *key)
+{
+    return _client_call(map, client, DELEGATE_DELETE, key, NIL_VAL).ok;
+}
+
+value_t hashmap_delegate_get(hashmap_delegate_t *map, delegate_client_t *client,
+                             const char *key)
+{
+    return _client_call(map, client, DELEGATE_GET, key, NIL_VAL).value;
+}
@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef HASHMAP_DELEGATE_H_SHARED
+#define HASHMAP_DELEGATE_H_SHARED
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "map.h"
+#include "sync.h"
+#include "value.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//                          Delegated HashMap Typing                          //
+////////////////////////////////////////////////////////////////////////////////
+
+// Shared-nothing map: the key space is split by hash between owner threads,
+// one per core, and only an owner ever touches its partition's hashmap_t.
+// Every other thread is a client that sends requests to the owner through a
+// single-producer/single-consumer ring per (client, owner) pair and reads
+// the answers back from a matching response ring. Owners serve each ring in
+// batches of up to DELEGATE_BATCH, publishing the ring indices once per
+// batch, so table accesses stay core-local and the only shared cache lines
+// are the ring indices themselves.
+//
+// An owner that has found nothing to serve for DELEGATE_PARK_ROUNDS polls in
+// a row parks on a condition variable, and the next request sent to it wakes
+// it, so an idle map does not keep every core busy.
+#define DELEGATE_RING_SIZE 64 // power of two
+#define DELEGATE_BATCH 32
+#define DELEGATE_MAX_CLIENTS 64
+#define DELEGATE_PARK_ROUNDS (HM_IDLE_SPINS * 64)
+
+typedef enum delegate_op_t {
+    DELEGATE_ADD = 1,
+    DELEGATE_UPSERT,
+    DELEGATE_DELETE,
+    DELEGATE_GET,
+} delegate_op_t;
+
+// Requests carry the key and value in, responses the value (for gets) and
+// whether the operation succeeded out, both tagged with the client's ticket.
+typedef struct delegate_msg_t {
+    uint64_t ticket;
+    const char *key;
+    value_t value;
+    uint32_t op;
+    uint32_t ok;
+} delegate_msg_t;
+
+typedef struct delegate_ring_t {
+    _Alignas(HM_CACHE_LINE) _Atomic uint32_t tail; // producer side
+    uint32_t head_cache;
+    _Alignas(HM_CACHE_LINE) _Atomic uint32_t head; // consumer side
+    uint32_t tail_cache;
+    _Alignas(HM_CACHE_LINE) delegate_msg_t slots[DELEGATE_RING_SIZE];
+} delegate_ring_t;
+
+typedef struct delegate_client_t {
+    delegate_ring_t *requests;  // one per owner
+    delegate_ring_t *responses; // one per owner
+    delegate_msg_t *stash; // responses read past by a blocking call
+    int stash_head, stash_len, stash_cap;
+    int unpolled; // asynchronous requests whose results are not yet polled
+    int next_owner; // where polling resumes
+    uint64_t next_ticket;
+    _Atomic bool in_use; // slot taken by a client thread
+    _Atomic bool active; // rings are set up, owners serve them
+} delegate_client_t;
+
+typedef struct delegate_owner_t {
+    _Alignas(HM_CACHE_LINE) hashmap_t map;
+    pthread_t thread;
+    int id;
+    delegate_client_t *clients; // DELEGATE_MAX_CLIENTS slots
+    _Atomic bool stop;
+    _Alignas(HM_CACHE_LINE) _Atomic bool parked; // read by every submit
+    pthread_mutex_t park_lock;
+    pthread_cond_t wake;
+} delegate_owner_t;
+
+typedef struct hashmap_delegate_t {
+    delegate_owner_t *owners;
+    delegate_client_t *clients; // DELEGATE_MAX_CLIENTS slots
+    int nowners;
+} hashmap_delegate_t;
+
+////////////////////////////////////////////////////////////////////////////////
+//                        Delegated HashMap Life Cycle                        //
+////////////////////////////////////////////////////////////////////////////////
+
+// Starts `owners` owner threads (one per online CPU when 0), each pinned to
+// its core where the platform allows it, and splits `capacity` evenly between
+// their partitions. Owner maps copy their keys. Returns a map with NULL
+// owners on failure.
+hashmap_delegate_t hashmap_delegate_init(int owners, int capacity,
+                                         double load_factor_pct);
+// Stops and joins the owners, no client may still be using the map.
+void hashmap_delegate_free(hashmap_delegate_t *map);
+
+// Each client thread registers once. NULL is returned when all
+// DELEGATE_MAX_CLIENTS slots are taken. A client must have no requests in
+// flight when it unregisters.
+delegate_client_t *hashmap_delegate_register(hashmap_delegate_t *map);
+void hashmap_delegate_unregister(hashmap_delegate_t *map,
+                                 delegate_client_t *client);
+
+////////////////////////////////////////////////////////////////////////////////
+//                        Delegated HashMap Requests                          //
+////////////////////////////////////////////////////////////////////////////////
+
+// Asynchronous interface. Submit fails without blocking when the owner's
+// request ring is full, or when the client already has as many unpolled
+// results as its stash holds, in which case poll for results and retry. The
+// key must stay valid until the request's result has been polled.
+bool hashmap_delegate_submit(hashmap_delegate_t *map, delegate_client_t *client,
+                             delegate_op_t op, const char *key, value_t value,
+                             uint64_t *ticket);
+// Pops one completed request, returning false if none are ready.
+bool hashmap_delegate_poll(hashmap_delegate_t *map, delegate_client_t *client,
+                           delegate_msg_t *result);
+
+// Blocking interface, results of earlier asynchronous requests that arrive
+// in the meantime are kept for hashmap_delegate_poll.
+bool hashmap_delegate_add(hashmap_delegate_t *map, delegate_client_t *client,
+                          const char *key, value_t value);
+bool hashmap_delegate_upsert(hashmap_delegate_t *map,
+                             delegate_client_t *client, const char *key,
+                             value_t value);
+bool hashmap_delegate_delete(hashmap_delegate_t *map,
+                             delegate_client_t *client, const char *key);
+value_t hashmap_delegate_get(hashmap_delegate_t *map, delegate_client_t *client,
+                             const char *key);
+
+#endif // !HASHMAP_DELEGATE_H_SHARED
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
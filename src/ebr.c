@@ -0,0 +1,186 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ebr.h"
+#include "sync.h"
+
+static void _ebr_drain(ebr_limbo_t *limbo)
+{
+    for (int i = 0; i < limbo->len; ++i)
+        limbo->items[i].free_fn(limbo->items[i].ptr);
+    limbo->len = 0;
+}
+
+// Frees every limbo list retired at least two epochs before `epoch`, no
+// thread pinned at or after `epoch - 1` can have seen their contents.
+static void _ebr_reclaim(ebr_thread_t *thread, uint64_t epoch)
+{
+    for (int i = 0; i < 3; ++i) {
+        if (thread->limbo[i].len > 0 && thread->limbo[i].epoch + 2 <= epoch)
+            _ebr_drain(thread->limbo + i);
+    }
+}
+
+// The global epoch only moves on once every pinned thread (bar `ignore`) has
+// observed its current value.
+static bool _ebr_try_advance(hashmap_ebr_t *ebr, ebr_thread_t *ignore)
+{
+    uint64_t epoch = atomic_load(&ebr->epoch);
+    atomic_thread_fence(memory_order_seq_cst);
+    for (int i = 0; i < EBR_MAX_THREADS; ++i) {
+        ebr_thread_t *thread = ebr->threads + i;
+        if (thread == ignore)
+            continue;
+        uint64_t seen =
+                atomic_load_explicit(&thread->epoch, memory_order_acquire);
+        if (seen != 0 && seen != epoch)
+            return false;
+    }
+    return atomic_compare_exchange_strong(&ebr->epoch, &epoch, epoch + 1);
+}
+
+static void _ebr_release(void *arg)
+{
+    ebr_thread_t *thread = (ebr_thread_t *)arg;
+    thread->depth = 0;
+    atomic_store_explicit(&thread->epoch, 0, memory_order_release);
+    atomic_store_explicit(&thread->in_use, false, memory_order_release);
+}
+
+hashmap_ebr_t hashmap_ebr_init(void)
+{
+    hashmap_ebr_t ebr = {0};
+    ebr.threads = (ebr_thread_t *)aligned_alloc(
+            HM_CACHE_LINE, EBR_MAX_THREADS * sizeof(ebr_thread_t));
+    if (ebr.threads == NULL)
+        return ebr;
+    if (pthread_key_create(&ebr.self, _ebr_release) != 0) {
+        free(ebr.threads);
+        ebr.threads = NULL;
+        return ebr;
+    }
+    memset(ebr.threads, 0, EBR_MAX_THREADS * sizeof(ebr_thread_t));
+    for (int i = 0; i < EBR_MAX_THREADS; ++i) {
+        atomic_init(&ebr.threads[i].epoch, 0);
+        atomic_init(&ebr.threads[i].in_use, false);
+    }
+    atomic_init(&ebr.epoch, 1); // 0 marks a quiescent thread
+    return ebr;
+}
+
+void hashmap_ebr_free(hashmap_ebr_t *ebr)
+{
+    if (ebr->threads == NULL)
+        return;
+    pthread_key_delete(ebr->self);
+    for (int i = 0; i < EBR_MAX_THREADS; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            _ebr_drain(ebr->threads[i].limbo + j);
+            free(ebr->threads[i].limbo[j].items);
+        }
+    }
+    free(ebr->threads);
+    ebr->threads = NULL;
+}
+
+ebr_thread_t *hashmap_ebr_register(hashmap_ebr_t *ebr)
+{
+    for (int i = 0; i < EBR_MAX_THREADS; ++i) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&ebr->threads[i].in_use, &expected,
+                                           true))
+            return ebr->threads + i;
+    }
+    return NULL;
+}
+
+void hashmap_ebr_unregister(hashmap_ebr_t *ebr, ebr_thread_t *thread)
+{
+    if (pthread_getspecific(ebr->self) == thread)
+        pthread_setspecific(ebr->self, NULL);
+    _ebr_release(thread);
+}
+
+ebr_thread_t *hashmap_ebr_self(hashmap_ebr_t *ebr)
+{
+    ebr_thread_t *thread = (ebr_thread_t *)pthread_getspecific(ebr->self);
+    if (thread != NULL)
+        return thread;
+    thread = hashmap_ebr_register(ebr);
+    if (thread != NULL && pthread_setspecific(ebr->self, thread) != 0) {
+        _ebr_release(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+void hashmap_ebr_enter(hashmap_ebr_t *ebr, ebr_thread_t *thread)
+{
+    if (thread->depth++ > 0)
+        return;
+    atomic_store_explicit(&thread->epoch,
+                          atomic_load_explicit(&ebr->epoch,
+                                               memory_order_relaxed),
+                          memory_order_release);
+    // Publish the pin before reading anything it protects.
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+void hashmap_ebr_exit(hashmap_ebr_t *ebr, ebr_thread_t *thread)
+{
+    if (--thread->depth > 0)
+        return;
+    atomic_store_explicit(&thread->epoch, 0, memory_order_release);
+}
+
+void hashmap_ebr_retire(hashmap_ebr_t *ebr, ebr_thread_t *thread, void *ptr,
+                        HM_EBR_FREE free_fn)
+{
+    uint64_t epoch = atomic_load(&ebr->epoch);
+    ebr_limbo_t *limbo = thread->limbo + epoch % 3;
+    if (limbo->epoch != epoch) {
+        // Same bucket, so retired at least three epochs ago.
+        _ebr_drain(limbo);
+        limbo->epoch = epoch;
+    }
+
+    if (limbo->len == limbo->cap) {
+        int cap = limbo->cap == 0 ? EBR_BATCH : limbo->cap * 2;
+        ebr_retired_t *grown = (ebr_retired_t *)realloc(
+                limbo->items, cap * sizeof(ebr_retired_t));
+        if (grown == NULL) {
+            // Wait out two epochs instead, ignoring our own pin as the
+            // caller has already unlinked `ptr`.
+            while (atomic_load(&ebr->epoch) < epoch + 2) {
+                if (!_ebr_try_advance(ebr, thread))
+                    hm_cpu_relax();
+            }
+            free_fn(ptr);
+            return;
+        }
+        limbo->items = grown;
+        limbo->cap = cap;
+    }
+    limbo->items[limbo->len].ptr = ptr;
+    limbo->items[limbo->len].free_fn = free_fn;
+    limbo->len++;
+
+    if (++thread->since_collect >= EBR_BATCH)
+        hashmap_ebr_collect(ebr, thread);
+}
+
+bool hashmap_ebr_collect(hashmap_ebr_t *ebr, ebr_thread_t *thread)
+{
+    thread->since_collect = 0;
+    bool advanced = _ebr_try_advance(ebr, NULL);
+    _ebr_reclaim(thread, atomic_load(&ebr->epoch));
+    return advanced;
+}
@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef HASHMAP_EBR_H_SHARED
+#define HASHMAP_EBR_H_SHARED
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sync.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//                     Epoch-Based Reclamation Typing                         //
+////////////////////////////////////////////////////////////////////////////////
+
+// Memory unlinked from a shared structure is retired rather than freed, and is
+// only handed to its free function once every thread that could still hold a
+// pointer to it has left its critical section:
+//
+// - a thread pins the global epoch on entry by storing it into its own
+//   cache-line padded slot (a plain store and fence, no read-modify-write),
+// - retired pointers go on the retiring thread's limbo list for the epoch
+//   they were retired in,
+// - every EBR_BATCH retires the thread tries to advance the global epoch,
+//   which only succeeds once all pinned threads have caught up with it, and
+//   frees its limbo lists that are two or more epochs old.
+//
+// Garbage is therefore bounded by roughly three batches per thread unless a
+// thread stays pinned indefinitely.
+#define EBR_MAX_THREADS 128
+#define EBR_BATCH 64
+
+typedef void (*HM_EBR_FREE)(void *ptr);
+
+typedef struct ebr_retired_t {
+    void *ptr;
+    HM_EBR_FREE free_fn;
+} ebr_retired_t;
+
+typedef struct ebr_limbo_t {
+    uint64_t epoch; // epoch every entry was retired in
+    ebr_retired_t *items;
+    int len, cap;
+} ebr_limbo_t;
+
+typedef struct ebr_thread_t {
+    _Alignas(HM_CACHE_LINE) _Atomic uint64_t epoch; // 0 while quiescent
+    _Atomic bool in_use;
+    int depth;           // owner only, nesting of enter/exit
+    int since_collect;   // owner only, retires since the last collect
+    ebr_limbo_t limbo[3]; // owner only, indexed by epoch % 3
+} ebr_thread_t;
+
+typedef struct hashmap_ebr_t {
+    _Alignas(HM_CACHE_LINE) _Atomic uint64_t epoch;
+    ebr_thread_t *threads; // EBR_MAX_THREADS slots
+    pthread_key_t self;    // calling thread's slot, see hashmap_ebr_self
+} hashmap_ebr_t;
+
+////////////////////////////////////////////////////////////////////////////////
+//                       Epoch-Based Reclamation API                          //
+////////////////////////////////////////////////////////////////////////////////
+
+// Returns a domain with NULL threads on failure. Freeing it frees everything
+// still retired, so no thread may be inside a critical section at that point.
+hashmap_ebr_t hashmap_ebr_init(void);
+void hashmap_ebr_free(hashmap_ebr_t *ebr);
+
+// Explicit registration, NULL is returned once all EBR_MAX_THREADS slots are
+// taken. An unregistered slot keeps its limbo lists for the next thread to
+// register in it.
+ebr_thread_t *hashmap_ebr_register(hashmap_ebr_t *ebr);
+void hashmap_ebr_unregister(hashmap_ebr_t *ebr, ebr_thread_t *thread);
+
+// The calling thread's slot, registered on first use and released again
+// when the thread exits. The domain must therefore not be moved after the
+// first call.
+ebr_thread_t *hashmap_ebr_self(hashmap_ebr_t *ebr);
+
+// Critical sections may nest, only the outermost enter pins the epoch.
+void hashmap_ebr_enter(hashmap_ebr_t *ebr, ebr_thread_t *thread);
+void hashmap_ebr_exit(hashmap_ebr_t *ebr, ebr_thread_t *thread);
+
+// Queues `ptr` to be passed to `free_fn` once no thread can still see it.
+// Allocation failures of the limbo list fall back to waiting for quiescence
+// and freeing `ptr` straight away.
+void hashmap_ebr_retire(hashmap_ebr_t *ebr, ebr_thread_t *thread, void *ptr,
+                        HM_EBR_FREE free_fn);
+
+// Tries to advance the global epoch and frees whatever `thread` has retired
+// that is now safe to free. Returns whether the epoch advanced.
+bool hashmap_ebr_collect(hashmap_ebr_t *ebr, ebr_thread_t *thread);
+
+#endif // !HASHMAP_EBR_H_SHARED
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
@@ -0,0 +1,203 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "frozen.h"
+#include "map.h"
+#include "xxhash.h"
+
+// Average number of keys per pilot bucket, larger values shrink the pilot array
+// (32/FROZEN_LAMBDA bits per key) at the cost of longer pilot searches.
+#define FROZEN_LAMBDA 5
+
+// Keys per slot. At a load of exactly 1 the last bucket placed must hit the
+// one slot left, which takes about `size` pilot tries.
+#define FROZEN_ALPHA 0.99
+
+// Give up on a seed once any bucket needs more pilots than this, duplicate
+// 64-bit hashes can never be separated and would otherwise spin forever.
+#define FROZEN_MAX_PILOT (1u << 24)
+#define FROZEN_MAX_SEEDS 16
+
+typedef struct frozen_key_t {
+    uint64_t hash;
+    int entry; // index into the collected bucket_t entries
+} frozen_key_t;
+
+static inline uint64_t _mix64(uint64_t x)
+{
+    // splitmix64 finaliser
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+static inline uint32_t _frozen_bucket(uint64_t hash, int nbuckets)
+{
+    return (uint32_t)(((hash >> 32) * (uint64_t)nbuckets) >> 32);
+}
+
+static inline uint64_t _frozen_pos(uint64_t hash, uint32_t pilot, int size)
+{
+    return (hash ^ _mix64(pilot)) % (uint64_t)size;
+}
+
+// Assigns a pilot to every bucket, largest buckets first. Returns false when a
+// bucket cannot be placed, in which case the caller retries with a new seed.
+static bool _frozen_build(hashmap_frozen_t *frozen, bucket_t *entries,
+                          frozen_key_t *keys, int *offsets, int *order,
+                          uint8_t *taken, uint64_t *pos)
+{
+    int n = frozen->capacity, m = frozen->nbuckets;
+
+    memset(taken, 0, n);
+    for (int b = 0; b < m; ++b) {
+        int bucket = order[b];
+        int first = offsets[bucket], count = offsets[bucket + 1] - first;
+        if (count == 0)
+            break; // sorted by size, every remaining bucket is empty
+
+        uint32_t pilot = 0;
+        for (;; ++pilot) {
+            if (pilot >= FROZEN_MAX_PILOT)
+                return false;
+            int placed = 0;
+            for (; placed < count; ++placed) {
+                uint64_t p = _frozen_pos(keys[first + placed].hash, pilot, n);
+                if (taken[p])
+                    break;
+                taken[p] = 1;
+                pos[placed] = p;
+            }
+            if (placed == count)
+                break;
+            while (placed-- > 0)
+                taken[pos[placed]] = 0;
+        }
+
+        frozen->pilots[bucket] = pilot;
+        for (int k = 0; k < count; ++k)
+            frozen->slots[pos[k]] = entries[keys[first + k].entry];
+    }
+    return true;
+}
+
+hashmap_frozen_t hashmap_freeze(hashmap_t *map)
+{
+    hashmap_frozen_t frozen = {0};
+    bucket_t curr, empty = {0};
+    int n = 0;
+
+    bucket_t *entries =
+            (bucket_t *)calloc(map->buckets.capacity + 1, sizeof(bucket_t));
+    if (entries == NULL)
+        return frozen;
+    for (int i = 0; i < map->buckets.capacity; ++i) {
+        curr = vector_gpos_type(&map->buckets, bucket_t, i);
+        if (memcmp(&curr, &empty, sizeof(bucket_t)) == 0)
+            continue;
+        entries[n++] = curr;
+    }
+
+    int m = n / FROZEN_LAMBDA + 1;
+    int capacity = (int)((double)n / FROZEN_ALPHA) + 1;
+    frozen.size = n;
+    frozen.capacity = capacity;
+    frozen.nbuckets = m;
+    frozen.slots = (bucket_t *)calloc(capacity, sizeof(bucket_t));
+    frozen.pilots = (uint32_t *)calloc(m, sizeof(uint32_t));
+
+    frozen_key_t *keys = (frozen_key_t *)calloc(n + 1, sizeof(frozen_key_t));
+    int *offsets = (int *)calloc(m + 1, sizeof(int));
+    int *order = (int *)calloc(m, sizeof(int));
+    int *sizes = (int *)calloc(n + 2, sizeof(int));
+    uint8_t *taken = (uint8_t *)calloc(capacity, sizeof(uint8_t));
+    uint64_t *pos = (uint64_t *)calloc(n + 1, sizeof(uint64_t));
+
+    bool ok = frozen.slots != NULL && frozen.pilots != NULL && keys != NULL &&
+              offsets != NULL && order != NULL && sizes != NULL &&
+              taken != NULL && pos != NULL;
+
+    for (int attempt = 0; ok; ++attempt) {
+        if (attempt == FROZEN_MAX_SEEDS) {
+            ok = false;
+            break;
+        }
+        frozen.seed = attempt;
+
+        // Counting sort the keys by pilot bucket.
+        memset(offsets, 0, (m + 1) * sizeof(int));
+        for (int i = 0; i < n; ++i) {
+            uint64_t hash = XXH64(entries[i].key, strlen(entries[i].key),
+                                  frozen.seed);
+            offsets[_frozen_bucket(hash, m) + 1]++;
+            pos[i] = hash;
+        }
+        for (int b = 0; b < m; ++b)
+            offsets[b + 1] += offsets[b];
+        for (int i = 0; i < n; ++i) {
+            int b = _frozen_bucket(pos[i], m);
+            int at = offsets[b] + sizes[b]++;
+            keys[at].hash = pos[i];
+            keys[at].entry = i;
+        }
+        memset(sizes, 0, (n + 2) * sizeof(int));
+
+        // Then counting sort the buckets by size, largest first.
+        for (int b = 0; b < m; ++b)
+            sizes[offsets[b + 1] - offsets[b]]++;
+        for (int s = n, at = 0; s >= 0; --s) {
+            int count = sizes[s];
+            sizes[s] = at;
+            at += count;
+        }
+        for (int b = 0; b < m; ++b)
+            order[sizes[offsets[b + 1] - offsets[b]]++] = b;
+        memset(sizes, 0, (n + 2) * sizeof(int));
+
+        if (_frozen_build(&frozen, entries, keys, offsets, order, taken, pos))
+            break;
+    }
+
+    free(entries);
+    free(keys);
+    free(offsets);
+    free(order);
+    free(sizes);
+    free(taken);
+    free(pos);
+    if (!ok)
+        hashmap_frozen_free(&frozen);
+    return frozen;
+}
+
+void hashmap_frozen_free(hashmap_frozen_t *frozen)
+{
+    free(frozen->slots);
+    free(frozen->pilots);
+    frozen->slots = NULL;
+    frozen->pilots = NULL;
+    frozen->size = frozen->capacity = frozen->nbuckets = 0;
+}
+
+value_t hashmap_frozen_get(hashmap_frozen_t *frozen, const char *key)
+{
+    if (frozen->size == 0)
+        return NIL_VAL;
+
+    uint64_t hash = XXH64(key, strlen(key), frozen->seed);
+    uint32_t pilot = frozen->pilots[_frozen_bucket(hash, frozen->nbuckets)];
+    bucket_t *slot =
+            frozen->slots + _frozen_pos(hash, pilot, frozen->capacity);
+    if (slot->key == NULL || strcmp(slot->key, key) != 0)
+        return NIL_VAL;
+    return slot->value;
+}
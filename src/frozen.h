@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef HASHMAP_FROZEN_H_SHARED
+#define HASHMAP_FROZEN_H_SHARED
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "map.h"
+#include "value.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//                            Frozen HashMap Typing                           //
+////////////////////////////////////////////////////////////////////////////////
+
+// A frozen map is an immutable snapshot of a hashmap_t's key-set laid out by a
+// minimal perfect hash (PTHash style); keys are grouped into buckets by their
+// hash and every bucket stores a "pilot" that displaces all of its keys onto
+// distinct free slots. A lookup is a single slot access plus one key compare.
+// The slot array keeps about 1% of its slots free (FROZEN_ALPHA), as PTHash
+// does, so the last buckets placed still find a free slot in a few tries.
+typedef struct hashmap_frozen_t {
+    bucket_t *slots;  // `capacity` slots, `size` of them holding a key
+    uint32_t *pilots; // `nbuckets` pilot values
+    int size, capacity, nbuckets;
+    uint64_t seed; // XXH64 seed - bumped whenever a build attempt fails
+} hashmap_frozen_t;
+
+////////////////////////////////////////////////////////////////////////////////
+//                          Frozen HashMap Life Cycle                         //
+////////////////////////////////////////////////////////////////////////////////
+
+// Keys are borrowed from `map` (as hashmap_t itself does) and must outlive the
+// frozen map. The source map may keep being modified afterwards, and freed
+// unless it owns its keys (`owns_keys`), as freeing it would free them too.
+hashmap_frozen_t hashmap_freeze(hashmap_t *map);
+void hashmap_frozen_free(hashmap_frozen_t *frozen);
+
+////////////////////////////////////////////////////////////////////////////////
+//                           Frozen HashMap Lookups                           //
+////////////////////////////////////////////////////////////////////////////////
+
+// Same semantics as hashmap_get - NIL_VAL is returned for missing keys.
+value_t hashmap_frozen_get(hashmap_frozen_t *frozen, const char *key);
+
+#endif // !HASHMAP_FROZEN_H_SHARED
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
@@ -10,24 +10,31 @@
 
 #include "assert.h"
 #include "map.h"
+#include "metrics.h"
+#include "pool.h"
+#include "probes.h"
 #include "vector.h"
+#include "wal.h"
 #include "xxhash.h"
 
+#ifdef HASHMAP_PROBES
+HM_PROBE_SEMAPHORE(add_entry);
+HM_PROBE_SEMAPHORE(add_return);
+HM_PROBE_SEMAPHORE(get_hit);
+HM_PROBE_SEMAPHORE(get_miss);
+HM_PROBE_SEMAPHORE(resize_start);
+HM_PROBE_SEMAPHORE(resize_end);
+#endif
+
 uint64_t _default_hasher(hashmap_t *map, const char *key, const int len)
 {
     if (strlen(key) != len)
         return ~(0);
 
-    XXH64_state_t *xhstate;
-    XXH_errorcode xherr;
     XXH64_hash_t xhhash;
     int reduced;
 
-    xhstate = XXH64_createState();
-    xherr = XXH64_update(xhstate, key, len);
-    if (xherr == XXH_ERROR)
-        return ~(0);
-    xhhash = XXH64_digest(xhstate);
+    xhhash = XXH64(key, len, 0);
 
     // printf("Hash: %llu %s\n", xhhash, key);
 
@@ -37,14 +44,14 @@ uint64_t _default_hasher(hashmap_t *map, const char *key, const int len)
     // printf("Start: %d %s\n", reduced, key);
     bucket_t curr = vector_gpos_type(&map->buckets, bucket_t, reduced);
     while (memcmp(&curr, &empty, sizeof(bucket_t)) != 0) {
-        if (memcmp(curr.key, key, len) == 0)
+        if (strcmp(curr.key, key) == 0)
             break;
         // printf("Probing...\n");
         reduced = (reduced + 1) % map->buckets.capacity;
         curr = vector_gpos_type(&map->buckets, bucket_t, reduced);
+        METRICS_COUNT(map, probe_steps, 1);
     }
     // printf("End: %d %s\n", reduced, key);
-    XXH64_freeState(xhstate);
     return reduced;
 }
 
@@ -65,16 +72,45 @@ hashmap_t hashmap_init(int capacity, double resize_pct, HM_KEY_HASHER hasher_fn)
             // and the key-set is rehashed and "re-housed" in
             // accordance with the new bucket array length.
             .hasher_fn = hasher_fn};
+#ifdef HASHMAP_METRICS
+    map.metrics = (hashmap_metrics_t *)calloc(1, sizeof(hashmap_metrics_t));
+#endif
 
     return map;
 }
 
-void hashmap_free(hashmap_t *map) { vector_free_type(&map->buckets, bucket_t); }
+void hashmap_free(hashmap_t *map)
+{
+    bucket_t curr, empty = {0};
+    if (map->owns_keys) {
+        for (int i = 0; i < map->buckets.capacity; ++i) {
+            curr = vector_gpos_type(&map->buckets, bucket_t, i);
+            if (memcmp(&curr, &empty, sizeof(bucket_t)) != 0)
+                free((char *)curr.key);
+        }
+    }
+    vector_free_type(&map->buckets, bucket_t);
+    map->key_bytes = 0;
+#ifdef HASHMAP_METRICS
+    free(map->metrics);
+    map->metrics = NULL;
+#endif
+}
 
 bool hashmap_rehash(hashmap_t *map)
 {
     bucket_t curr, empty = {0};
+    // The serial rehash below is the fallback should the workers' array not
+    // be allocated.
+    if (map->pool != NULL && map->hasher_fn == _default_hasher &&
+        map->buckets.capacity >= POOL_REHASH_MIN_SLOTS &&
+        hashmap_rehash_parallel(map, map->pool))
+        return true;
+
     vector_bucket_t clone = vector_clone_type(&map->buckets, bucket_t);
+    if (clone.array == NULL)
+        return false;
+    int size = map->buckets.size, end_ptr = map->buckets.end_ptr;
     vector_empty_type(&map->buckets, bucket_t);
     bool success = true;
     for (int i = 0; i < clone.capacity; ++i) {
@@ -92,40 +128,295 @@ bool hashmap_rehash(hashmap_t *map)
             break;
         }
     }
+    if (!success) {
+        memcpy(map->buckets.array, clone.array,
+               (size_t)clone.capacity * sizeof(bucket_t));
+        map->buckets.size = size;
+        map->buckets.end_ptr = end_ptr;
+    }
+    vector_free_type(&clone, bucket_t);
     return success;
 }
 
-bool hashmap_add(hashmap_t *map, const char *key, value_t value)
+static inline size_t _alloc_slack(size_t bytes)
+{
+    size_t chunk = (bytes + HM_MALLOC_HEADER + HM_MALLOC_ALIGN - 1) &
+                   ~(size_t)(HM_MALLOC_ALIGN - 1);
+    return chunk - bytes;
+}
+
+// Whether adding `key` keeps the map within max_bytes, see map.h. Notes
+// whether the key is `present` already, as replacing it must not grow.
+static bool _hashmap_within_budget(hashmap_t *map, const char *key,
+                                   bool *present)
+{
+    bucket_t curr, empty = {0};
+    int idx = map->hasher_fn(map, key, strlen(key));
+    curr = vector_gpos_type(&map->buckets, bucket_t, idx);
+    *present = memcmp(&curr, &empty, sizeof(bucket_t)) != 0;
+    if (*present)
+        return true;
+
+    size_t key_bytes = map->owns_keys ? strlen(key) + 1 : 0;
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        size_t capacity = (size_t)map->buckets.capacity;
+        if ((double)(map->buckets.size + 1) >
+            (double)capacity * map->buckets.load_factor_pct)
+            capacity *= 2;
+        size_t need = capacity * sizeof(bucket_t) + map->key_bytes + key_bytes;
+        if (need <= map->max_bytes)
+            return true;
+        if (attempt > 0 || map->on_over_budget == NULL ||
+            !map->on_over_budget(map, need - map->max_bytes))
+            return false;
+    }
+    return false;
+}
+
+// Doubles the bucket array, timing the pause and telling the resize hook.
+// Every start is paired with an end, a failed growth ending with no entries
+// moved and the old capacity still in place.
+static bool _hashmap_grow(hashmap_t *map)
+{
+    hashmap_resize_t resize = {
+            .old_capacity = map->buckets.capacity,
+            .new_capacity = 2 * map->buckets.capacity,
+    };
+    if (map->on_resize != NULL)
+        map->on_resize(map, false, &resize);
+    HM_PROBE2(resize_start, resize.old_capacity, resize.new_capacity);
+
+    uint64_t begin = _metrics_now();
+    bool grown =
+            vector_resize_type(&map->buckets, bucket_t, resize.new_capacity);
+    if (grown && !hashmap_rehash(map)) {
+        // The old layout is still intact in the first old_capacity slots,
+        // so shrinking the capacity back needs no allocation.
+        map->buckets.capacity = resize.old_capacity;
+        grown = false;
+    }
+    resize.moved = grown ? map->buckets.size : 0;
+    resize.elapsed_ns = _metrics_now() - begin;
+
+    if (grown) {
+        hashmap_pauses_t *pauses = &map->pauses;
+        pauses->resizes++;
+        pauses->total_ns += resize.elapsed_ns;
+        if (resize.elapsed_ns > pauses->max_ns)
+            pauses->max_ns = resize.elapsed_ns;
+        METRICS_COUNT(map, resizes, 1);
+        METRICS_RECORD(map, METRICS_REHASH, begin);
+    }
+    HM_PROBE3(resize_end, resize.old_capacity, resize.new_capacity,
+              resize.elapsed_ns);
+    if (map->on_resize != NULL)
+        map->on_resize(map, true, &resize);
+    return grown;
+}
+
+static bool _hashmap_insert(hashmap_t *map, const char *key, value_t value)
 {
+    bucket_t curr, empty = {0};
     bucket_t bucket = {
             .key = key,
             .value = value,
     };
 
-    if ((double)(map->buckets.size + 1) >
+    bool present = false;
+    if (map->max_bytes > 0 && !_hashmap_within_budget(map, key, &present))
+        return false;
+    if (!present && (double)(map->buckets.size + 1) >
         (double)(map->buckets.capacity) * map->buckets.load_factor_pct) {
-        if (!vector_resize_type(&map->buckets, bucket_t,
-                                2 * map->buckets.capacity))
+        if (!_hashmap_grow(map))
             return false;
-        hashmap_rehash(map);
     }
 
     int idx = map->hasher_fn( // hasher_fn **should** handle collisions
             map, key,         // (linear/quadratic probing) in the open
             strlen(key));     // addressing key addressing system
 
-    return vector_spos_type(&map->buckets, bucket_t, bucket, idx);
+    // Re-adding a key replaces its bucket in place without growing the size,
+    // maps owning their keys hold on to the copy they already made.
+    curr = vector_gpos_type(&map->buckets, bucket_t, idx);
+    if (memcmp(&curr, &empty, sizeof(bucket_t)) != 0) {
+        if (map->owns_keys)
+            bucket.key = curr.key;
+        map->buckets.array[idx] = bucket;
+        return true;
+    }
+
+    if (map->owns_keys) {
+        size_t len = strlen(key) + 1;
+        char *owned = (char *)malloc(len);
+        if (owned == NULL)
+            return false;
+        bucket.key = memcpy(owned, key, len);
+    }
+    if (!vector_spos_type(&map->buckets, bucket_t, bucket, idx)) {
+        if (map->owns_keys)
+            free((char *)bucket.key);
+        return false;
+    }
+    if (map->owns_keys)
+        map->key_bytes += strlen(key) + 1;
+    return true;
+}
+
+bool hashmap_add(hashmap_t *map, const char *key, value_t value)
+{
+    METRICS_START(begin);
+    HM_PROBE1(add_entry, key);
+    // Room for the record is made up front so a key that is inserted is
+    // always logged, and one that is rejected never is.
+    bool success = map->wal == NULL || hashmap_wal_reserve(map->wal, key);
+    success = success && _hashmap_insert(map, key, value);
+    if (success && map->wal != NULL)
+        hashmap_wal_append(map->wal, WAL_OP_ADD, key, value);
+    HM_PROBE2(add_return, key, success);
+    METRICS_COUNT(map, adds, 1);
+    METRICS_RECORD(map, METRICS_ADD, begin);
+    return success;
+}
+
+bool hashmap_upsert(hashmap_t *map, const char *key, value_t value)
+{
+    bucket_t curr, empty = {0};
+    bool success = true;
+    METRICS_START(begin);
+
+    // Unlike hashmap_add the existing key is probed for first, so updates
+    // never trigger a resize and keep the originally stored key.
+    int idx = map->hasher_fn(map, key, strlen(key));
+    curr = vector_gpos_type(&map->buckets, bucket_t, idx);
+    if (map->wal != NULL && !hashmap_wal_reserve(map->wal, key))
+        return false;
+    if (memcmp(&curr, &empty, sizeof(bucket_t)) == 0)
+        success = _hashmap_insert(map, key, value);
+    else
+        map->buckets.array[idx].value = value;
+    if (success && map->wal != NULL)
+        hashmap_wal_append(map->wal, WAL_OP_UPSERT, key, value);
+    METRICS_COUNT(map, adds, 1);
+    METRICS_RECORD(map, METRICS_ADD, begin);
+    return success;
+}
+
+bool hashmap_delete(hashmap_t *map, const char *key)
+{
+    bucket_t curr, empty = {0};
+    int idx, next;
+    METRICS_START(begin);
+
+    idx = map->hasher_fn(map, key, strlen(key));
+    curr = vector_gpos_type(&map->buckets, bucket_t, idx);
+    METRICS_COUNT(map, deletes, 1);
+    if (memcmp(&curr, &empty, sizeof(bucket_t)) == 0) {
+        METRICS_RECORD(map, METRICS_DELETE, begin);
+        return false;
+    }
+
+    if (map->wal != NULL &&
+        !hashmap_wal_append(map->wal, WAL_OP_DELETE, key, NIL_VAL))
+        return false;
+
+    if (map->owns_keys) {
+        map->key_bytes -= strlen(curr.key) + 1;
+        free((char *)curr.key);
+    }
+    map->buckets.array[idx] = empty;
+    map->buckets.size--;
+
+    // No tombstones are left behind; instead every following bucket in the
+    // cluster is re-housed so probes never stop early at the freed slot.
+    next = (idx + 1) % map->buckets.capacity;
+    curr = vector_gpos_type(&map->buckets, bucket_t, next);
+    while (memcmp(&curr, &empty, sizeof(bucket_t)) != 0) {
+        map->buckets.array[next] = empty;
+        idx = map->hasher_fn(map, curr.key, strlen(curr.key));
+        map->buckets.array[idx] = curr;
+        next = (next + 1) % map->buckets.capacity;
+        curr = vector_gpos_type(&map->buckets, bucket_t, next);
+    }
+    METRICS_RECORD(map, METRICS_DELETE, begin);
+    return true;
+}
+
+// Slots a lookup ending at `idx` compared, worked out from the key's home
+// bucket, or -1 when the map has its own hasher.
+static inline int _probe_length(hashmap_t *map, const char *key, int idx)
+{
+    if (map->hasher_fn != _default_hasher || idx < 0)
+        return -1;
+    uint64_t capacity = (uint64_t)map->buckets.capacity;
+    uint64_t home = XXH64(key, strlen(key), 0) % capacity;
+    return (int)(((uint64_t)idx + capacity - home) % capacity) + 1;
 }
 
 value_t hashmap_get(hashmap_t *map, const char *key)
 {
     bucket_t curr, empty = {0};
     int idx;
+    METRICS_START(begin);
     idx = map->hasher_fn(map, key, strlen(key));
     curr = vector_gpos_type(&map->buckets, bucket_t, idx);
-    if (memcmp(&curr, &empty, sizeof(bucket_t)) == 0)
-        return NIL_VAL;
-    if (memcmp(curr.key, key, strlen(key)) != 0)
-        return NIL_VAL;
-    return curr.value;
+    bool hit = memcmp(&curr, &empty, sizeof(bucket_t)) != 0 &&
+               strcmp(curr.key, key) == 0;
+    METRICS_COUNT(map, gets, 1);
+    METRICS_COUNT(map, hits, hit);
+    METRICS_COUNT(map, misses, !hit);
+    METRICS_RECORD(map, METRICS_GET, begin);
+    if (HM_PROBE_ENABLED(get_hit) || HM_PROBE_ENABLED(get_miss)) {
+        int probes = _probe_length(map, key, idx);
+        if (hit)
+            HM_PROBE2(get_hit, key, probes);
+        else
+            HM_PROBE2(get_miss, key, probes);
+    }
+    return hit ? curr.value : NIL_VAL;
+}
+
+bool hashmap_clear(hashmap_t *map)
+{
+    bucket_t curr, empty = {0};
+
+    if (map->wal != NULL &&
+        !hashmap_wal_append(map->wal, WAL_OP_CLEAR, "", NIL_VAL))
+        return false;
+
+    if (map->owns_keys) {
+        for (int i = 0; i < map->buckets.capacity; ++i) {
+            curr = vector_gpos_type(&map->buckets, bucket_t, i);
+            if (memcmp(&curr, &empty, sizeof(bucket_t)) != 0)
+                free((char *)curr.key);
+        }
+    }
+    vector_empty_type(&map->buckets, bucket_t);
+    map->buckets.end_ptr = 0;
+    map->key_bytes = 0;
+    return true;
+}
+
+hashmap_memory_t hashmap_memory_usage(hashmap_t *map)
+{
+    bucket_t curr, empty = {0};
+    size_t table = (size_t)map->buckets.capacity * sizeof(bucket_t);
+    hashmap_memory_t usage = {
+            .table = table,
+            .control = sizeof(hashmap_t),
+            .slack = map->buckets.array != NULL ? _alloc_slack(table) : 0,
+    };
+    for (int i = 0; i < map->buckets.capacity; ++i) {
+        curr = vector_gpos_type(&map->buckets, bucket_t, i);
+        if (memcmp(&curr, &empty, sizeof(bucket_t)) == 0)
+            continue;
+        size_t len = strlen(curr.key) + 1;
+        if (map->owns_keys) {
+            usage.keys += len;
+            usage.slack += _alloc_slack(len);
+        } else {
+            usage.borrowed += len;
+        }
+    }
+    usage.total = usage.table + usage.control + usage.keys + usage.slack;
+    return usage;
 }
@@ -37,12 +37,51 @@ VECTOR_DEFINE(bucket_t)
 #endif /* ifndef _DYN_VEC_BUCKET_T */
 
 typedef struct hashmap_t hashmap_t;
+typedef struct hashmap_wal_t hashmap_wal_t;
+typedef struct hashmap_pool_t hashmap_pool_t;
+typedef struct hashmap_metrics_t hashmap_metrics_t;
 
 typedef uint64_t (*HM_KEY_HASHER)(hashmap_t *, const char *key, const int len);
+// Called with the bytes an insert would take the map over `max_bytes` by,
+// may delete entries to make room and returns whether to check again.
+typedef bool (*HM_OVER_BUDGET)(hashmap_t *map, size_t over);
+
+// One growth of the bucket array, as seen by HM_RESIZE_HOOK.
+typedef struct hashmap_resize_t {
+    int old_capacity, new_capacity;
+    int moved;           // entries rehashed, 0 before the resize
+    uint64_t elapsed_ns; // the resize and rehash, 0 before the resize
+} hashmap_resize_t;
+
+// Called right before (`done` false) and after (`done` true) the insert that
+// fills the map past its load factor grows it. Every call before is paired
+// with one after: when the growth fails (the bucket array or the rehash could
+// not be allocated) the call after reports 0 `moved` and the map keeps
+// `old_capacity`. The map must not be modified from the hook.
+typedef void (*HM_RESIZE_HOOK)(hashmap_t *map, bool done,
+                               const hashmap_resize_t *resize);
+
+// Pauses inserts have taken growing the map, kept whether or not a hook is
+// set.
+typedef struct hashmap_pauses_t {
+    uint64_t resizes;
+    uint64_t total_ns, max_ns;
+} hashmap_pauses_t;
 
 typedef struct hashmap_t {
     vector_bucket_t buckets;
     HM_KEY_HASHER hasher_fn;
+    bool owns_keys;       // keys are copied on insert and freed with the map
+    size_t key_bytes;     // held by owned keys, see hashmap_memory_usage
+    hashmap_wal_t *wal;   // optional mutation log, see wal.h
+    hashmap_pool_t *pool; // optional rehash workers, see pool.h
+    size_t max_bytes;     // optional table and owned key budget
+    HM_OVER_BUDGET on_over_budget;
+    HM_RESIZE_HOOK on_resize; // optional
+    hashmap_pauses_t pauses;
+#ifdef HASHMAP_METRICS
+    hashmap_metrics_t *metrics; // see metrics.h
+#endif
 } hashmap_t;
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -52,6 +91,8 @@ typedef struct hashmap_t {
 hashmap_t hashmap_init(int capacity, double load_factor_pct,
                        HM_KEY_HASHER hasher_fn);
 void hashmap_free(hashmap_t *map);
+// Re-houses every key for the current capacity. On failure the table is left
+// exactly as it was.
 bool hashmap_rehash(hashmap_t *map);
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -61,10 +102,41 @@ bool hashmap_rehash(hashmap_t *map);
 uint64_t _default_hasher(hashmap_t *map, const char *key, const int len);
 
 bool hashmap_add(hashmap_t *map, const char *key, value_t value);
+bool hashmap_upsert(hashmap_t *map, const char *key, value_t value);
 bool hashmap_delete(hashmap_t *map, const char *key);
 value_t hashmap_get(hashmap_t *map, const char *key);
 bool hashmap_clear(hashmap_t *map);
 
+////////////////////////////////////////////////////////////////////////////////
+//                               HashMap Memory                               //
+////////////////////////////////////////////////////////////////////////////////
+
+// The bucket array keeps no per-slot control bytes, so `control` is just the
+// hashmap_t header. `slack` estimates what malloc adds to the table and to
+// each owned key: a HM_MALLOC_HEADER byte header, rounded up to
+// HM_MALLOC_ALIGN. Keys the map only borrows are reported apart and left out
+// of `total`, as their owner accounts for them.
+#define HM_MALLOC_HEADER 8
+#define HM_MALLOC_ALIGN 16
+
+typedef struct hashmap_memory_t {
+    size_t table;    // bucket array, empty slots included
+    size_t control;  // hashmap_t header
+    size_t keys;     // owned key strings
+    size_t borrowed; // key strings owned by the caller
+    size_t slack;    // estimated allocator overhead
+    size_t total;    // table + control + keys + slack
+} hashmap_memory_t;
+
+// One pass over the bucket array.
+hashmap_memory_t hashmap_memory_usage(hashmap_t *map);
+
+// With `max_bytes` set, an insert that would take the bucket array (after
+// any growth it causes) plus the owned keys over the budget calls
+// `on_over_budget` once, if set, and fails without growing unless the map
+// then fits. Replacing a present key always fits. The old array freed during
+// a resize is not counted.
+
 #endif // !HASHMAP_H_SHARED
 
 #ifdef __cplusplus
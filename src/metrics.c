@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "map.h"
+#include "metrics.h"
+
+#define METRICS_SUB_MASK ((1 << METRICS_SUB_BITS) - 1)
+
+static inline int _metrics_bucket(uint64_t ns)
+{
+    if (ns <= METRICS_SUB_MASK)
+        return (int)ns;
+    int msb = 63 - __builtin_clzll(ns);
+    int shift = msb - METRICS_SUB_BITS;
+    return ((shift + 1) << METRICS_SUB_BITS) +
+           (int)((ns >> shift) & METRICS_SUB_MASK);
+}
+
+static inline uint64_t _metrics_upper(int bucket)
+{
+    if (bucket <= METRICS_SUB_MASK)
+        return (uint64_t)bucket;
+    int shift = (bucket >> METRICS_SUB_BITS) - 1;
+    uint64_t sub = (uint64_t)(bucket & METRICS_SUB_MASK);
+    uint64_t lower = ((1ULL << METRICS_SUB_BITS) | sub) << shift;
+    return lower + (1ULL << shift) - 1;
+}
+
+uint64_t _metrics_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void _metrics_record(hashmap_metrics_t *metrics, metrics_op_t op,
+                     uint64_t start)
+{
+    if (metrics == NULL)
+        return;
+    uint64_t ns = _metrics_now() - start;
+    __atomic_fetch_add(&metrics->latency[op][_metrics_bucket(ns)], 1,
+                       __ATOMIC_RELAXED);
+    if (op == METRICS_REHASH)
+        __atomic_fetch_add(&metrics->rehash_ns, ns, __ATOMIC_RELAXED);
+}
+
+// hashmap_metrics_t is nothing but uint64_t counters, copied or cleared one
+// relaxed atomic at a time so concurrent updates are never torn.
+#define METRICS_WORDS (sizeof(hashmap_metrics_t) / sizeof(uint64_t))
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Metrics                                    //
+////////////////////////////////////////////////////////////////////////////////
+
+bool hashmap_metrics_read(hashmap_t *map, hashmap_metrics_t *out)
+{
+#ifdef HASHMAP_METRICS
+    if (map->metrics == NULL)
+        return false;
+    uint64_t *from = (uint64_t *)map->metrics, *to = (uint64_t *)out;
+    for (size_t i = 0; i < METRICS_WORDS; ++i)
+        to[i] = __atomic_load_n(from + i, __ATOMIC_RELAXED);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void hashmap_metrics_reset(hashmap_t *map)
+{
+#ifdef HASHMAP_METRICS
+    if (map->metrics == NULL)
+        return;
+    uint64_t *words = (uint64_t *)map->metrics;
+    for (size_t i = 0; i < METRICS_WORDS; ++i)
+        __atomic_store_n(words + i, 0, __ATOMIC_RELAXED);
+#endif
+}
+
+uint64_t hashmap_metrics_percentile(const hashmap_metrics_t *metrics,
+                                    metrics_op_t op, double pct)
+{
+    const uint64_t *bins = metrics->latency[op];
+    uint64_t samples = 0;
+    for (int i = 0; i < METRICS_LATENCY_BUCKETS; ++i)
+        samples += __atomic_load_n(bins + i, __ATOMIC_RELAXED);
+    if (samples == 0)
+        return 0;
+
+    uint64_t rank = (uint64_t)((double)samples * pct / 100.0 + 0.5);
+    if (rank < 1)
+        rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < METRICS_LATENCY_BUCKETS; ++i) {
+        seen += __atomic_load_n(bins + i, __ATOMIC_RELAXED);
+        if (seen >= rank)
+            return _metrics_upper(i);
+    }
+    return _metrics_upper(METRICS_LATENCY_BUCKETS - 1);
+}
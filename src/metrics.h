@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef HASHMAP_METRICS_H_SHARED
+#define HASHMAP_METRICS_H_SHARED
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "map.h"
+#include "value.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//                              Metrics Typing                                //
+////////////////////////////////////////////////////////////////////////////////
+
+// Operation counters and latency histograms kept by every map when the
+// library is built with HASHMAP_METRICS defined (`make lib HASHMAP_METRICS=1`).
+// Without it the hooks in map.c expand to nothing, hashmap_t has no metrics
+// field and hashmap_metrics_read always fails. The library and its users must
+// agree on the flag, as it changes the layout of hashmap_t.
+//
+// Latencies are binned HDR style: below 2^METRICS_SUB_BITS ns one bucket per
+// nanosecond, above it every power of two split into 2^METRICS_SUB_BITS
+// linear buckets, so a bucket is never wider than 25% of its value.
+//
+// Every counter and bin is updated with a relaxed atomic add, as maps are
+// read concurrently (hashmap_get under a sharded map's shared lock), and
+// read back one relaxed load at a time; a snapshot taken mid-update may mix
+// counts from before and after it, but no count is ever lost.
+#define METRICS_SUB_BITS 2
+#define METRICS_LATENCY_BUCKETS                                                \
+    ((64 - METRICS_SUB_BITS + 1) << METRICS_SUB_BITS)
+
+typedef enum metrics_op_t {
+    METRICS_ADD, // hashmap_add and hashmap_upsert
+    METRICS_GET,
+    METRICS_DELETE,
+    METRICS_REHASH, // growth, the resize and rehash together
+    METRICS_OPS,
+} metrics_op_t;
+
+typedef struct hashmap_metrics_t {
+    uint64_t adds, gets, hits, misses, deletes;
+    uint64_t resizes;
+    uint64_t rehash_ns;   // spent growing, in total
+    uint64_t probe_steps; // slots `_default_hasher` stepped past
+    uint64_t latency[METRICS_OPS][METRICS_LATENCY_BUCKETS]; // ns histograms
+} hashmap_metrics_t;
+
+#ifdef HASHMAP_METRICS
+#define METRICS_START(name) uint64_t name = _metrics_now()
+#define METRICS_COUNT(map, field, n)                                           \
+    do {                                                                       \
+        if ((map)->metrics != NULL)                                            \
+            __atomic_fetch_add(&(map)->metrics->field, (uint64_t)(n),          \
+                               __ATOMIC_RELAXED);                              \
+    } while (0)
+#define METRICS_RECORD(map, op, start)                                         \
+    _metrics_record((map)->metrics, op, start)
+#else
+#define METRICS_START(name) ((void)0)
+#define METRICS_COUNT(map, field, n) ((void)0)
+#define METRICS_RECORD(map, op, start) ((void)0)
+#endif
+
+// Used by the hooks above, returning and taking CLOCK_MONOTONIC nanoseconds.
+uint64_t _metrics_now(void);
+void _metrics_record(hashmap_metrics_t *metrics, metrics_op_t op,
+                     uint64_t start);
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Metrics                                    //
+////////////////////////////////////////////////////////////////////////////////
+
+// Copies the map's metrics to `out`. Fails when built without
+// HASHMAP_METRICS, or if the map's metrics could not be allocated.
+bool hashmap_metrics_read(hashmap_t *map, hashmap_metrics_t *out);
+void hashmap_metrics_reset(hashmap_t *map);
+// Latency in ns that `pct` percent of the `op` samples were at or under,
+// rounded up to their bucket's upper bound. 0 with no samples.
+uint64_t hashmap_metrics_percentile(const hashmap_metrics_t *metrics,
+                                    metrics_op_t op, double pct);
+
+#endif // !HASHMAP_METRICS_H_SHARED
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
@@ -0,0 +1,191 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "map.h"
+#include "pool.h"
+#include "xxhash.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Workers                                    //
+////////////////////////////////////////////////////////////////////////////////
+
+static void *_pool_worker(void *arg)
+{
+    pool_worker_t *self = (pool_worker_t *)arg;
+    hashmap_pool_t *pool = self->pool;
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->stop && pool->round == seen)
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        if (pool->stop)
+            break;
+        seen = pool->round;
+        HM_POOL_TASK task = pool->task;
+        void *task_arg = pool->arg;
+        pthread_mutex_unlock(&pool->lock);
+
+        task(task_arg, self->id, pool->nworkers + 1);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->running == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+hashmap_pool_t *hashmap_pool_open(int threads)
+{
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+    }
+    hashmap_pool_t *pool = (hashmap_pool_t *)calloc(1, sizeof(hashmap_pool_t));
+    if (pool == NULL)
+        return NULL;
+    pool->workers = (pool_worker_t *)calloc(threads, sizeof(pool_worker_t));
+    if (pool->workers == NULL) {
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->run, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (int i = 0; i < threads - 1; ++i) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].id = i;
+        if (pthread_create(&pool->workers[i].thread, NULL, _pool_worker,
+                           pool->workers + i) != 0)
+            break;
+        pool->nworkers++;
+    }
+    return pool;
+}
+
+void hashmap_pool_close(hashmap_pool_t *pool)
+{
+    if (pool == NULL)
+        return;
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->nworkers; ++i)
+        pthread_join(pool->workers[i].thread, NULL);
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_mutex_destroy(&pool->run);
+    free(pool->workers);
+    free(pool);
+}
+
+void hashmap_pool_run(hashmap_pool_t *pool, HM_POOL_TASK task, void *arg)
+{
+    pthread_mutex_lock(&pool->run);
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->arg = arg;
+    pool->running = pool->nworkers;
+    pool->round++;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    task(arg, pool->nworkers, pool->nworkers + 1);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->running > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+    pthread_mutex_unlock(&pool->run);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                               Parallel Rehash                              //
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct rehash_job_t {
+    bucket_t *from;
+    bucket_t *to;
+    int capacity;
+    _Atomic int moved;
+    _Atomic int end_ptr;
+} rehash_job_t;
+
+// Moves one worker's share of the old slots. The bucket array is plain
+// memory shared with the serial code, so the key is claimed with the
+// __atomic builtins; only the claiming worker ever writes the value, and the
+// pool's join publishes everything to the caller.
+static void _rehash_range(void *arg, int worker, int workers)
+{
+    rehash_job_t *job = (rehash_job_t *)arg;
+    uint64_t capacity = (uint64_t)job->capacity;
+    int begin = (int)((int64_t)job->capacity * worker / workers);
+    int end = (int)((int64_t)job->capacity * (worker + 1) / workers);
+    int moved = 0, last = -1;
+
+    for (int i = begin; i < end; ++i) {
+        const char *key = job->from[i].key;
+        if (key == NULL)
+            continue;
+        uint64_t idx = XXH64(key, strlen(key), 0) % capacity;
+        for (;; idx = (idx + 1) % capacity) {
+            bucket_t *slot = job->to + idx;
+            const char *stored = __atomic_load_n(&slot->key, __ATOMIC_RELAXED);
+            if (stored == NULL &&
+                __atomic_compare_exchange_n(&slot->key, &stored, key, false,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        job->to[idx].value = job->from[i].value;
+        moved++;
+        if ((int)idx > last)
+            last = (int)idx;
+    }
+
+    atomic_fetch_add_explicit(&job->moved, moved, memory_order_relaxed);
+    int seen = atomic_load_explicit(&job->end_ptr, memory_order_relaxed);
+    while (last + 1 > seen &&
+           !atomic_compare_exchange_weak_explicit(&job->end_ptr, &seen,
+                                                  last + 1,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed))
+        ;
+}
+
+bool hashmap_rehash_parallel(hashmap_t *map, hashmap_pool_t *pool)
+{
+    if (map->hasher_fn != _default_hasher)
+        return false;
+    rehash_job_t job = {
+            .from = map->buckets.array,
+            .to = (bucket_t *)calloc(map->buckets.capacity, sizeof(bucket_t)),
+            .capacity = map->buckets.capacity,
+    };
+    if (job.to == NULL)
+        return false;
+    atomic_init(&job.moved, 0);
+    atomic_init(&job.end_ptr, 0);
+
+    hashmap_pool_run(pool, _rehash_range, &job);
+
+    free(map->buckets.array);
+    map->buckets.array = job.to;
+    map->buckets.size = atomic_load(&job.moved);
+    map->buckets.end_ptr = atomic_load(&job.end_ptr);
+    return true;
+}
@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef HASHMAP_POOL_H_SHARED
+#define HASHMAP_POOL_H_SHARED
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "map.h"
+#include "value.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//                              Worker Pool Typing                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Fork-join pool for the bulk passes over a whole table. A run hands the same
+// task to every worker, the calling thread included, and returns once all of
+// them have finished; workers split the work between themselves by index.
+// Tables smaller than POOL_REHASH_MIN_SLOTS are still rehashed serially, as
+// waking the workers would cost more than the pass itself.
+#define POOL_REHASH_MIN_SLOTS (1 << 16)
+
+typedef void (*HM_POOL_TASK)(void *arg, int worker, int workers);
+
+typedef struct pool_worker_t {
+    struct hashmap_pool_t *pool;
+    pthread_t thread;
+    int id;
+} pool_worker_t;
+
+typedef struct hashmap_pool_t {
+    pool_worker_t *workers;
+    int nworkers; // helper threads, the caller runs as worker `nworkers`
+    pthread_mutex_t run;  // one run at a time
+    pthread_mutex_t lock; // guards everything below
+    pthread_cond_t wake, done;
+    HM_POOL_TASK task;
+    void *arg;
+    uint64_t round; // bumped by every run
+    int running;    // helpers yet to finish the current round
+    bool stop;
+} hashmap_pool_t;
+
+////////////////////////////////////////////////////////////////////////////////
+//                            Worker Pool Life Cycle                          //
+////////////////////////////////////////////////////////////////////////////////
+
+// Starts a pool running tasks on `threads` threads in total, the caller
+// included (one per online CPU when 0). Attach it to a map with
+// `map.pool = pool` and large rehashes are split between its workers.
+hashmap_pool_t *hashmap_pool_open(int threads);
+void hashmap_pool_close(hashmap_pool_t *pool);
+
+// Runs `task` on every worker and waits for all of them.
+void hashmap_pool_run(hashmap_pool_t *pool, HM_POOL_TASK task, void *arg);
+
+////////////////////////////////////////////////////////////////////////////////
+//                               Parallel Rehash                              //
+////////////////////////////////////////////////////////////////////////////////
+
+// Re-houses every bucket into a fresh array of the current capacity, each
+// worker moving a contiguous range of the old slots and claiming new ones
+// with a CAS on the key. Only valid for maps using `_default_hasher`, as it
+// reproduces that hasher's layout (XXH64 modulo capacity, linear probing).
+// Fails, with the table untouched, if the new slots cannot be allocated.
+bool hashmap_rehash_parallel(hashmap_t *map, hashmap_pool_t *pool);
+
+#endif // !HASHMAP_POOL_H_SHARED
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef HASHMAP_PROBES_H_SHARED
+#define HASHMAP_PROBES_H_SHARED
+
+////////////////////////////////////////////////////////////////////////////////
+//                              USDT Probes                                   //
+////////////////////////////////////////////////////////////////////////////////
+
+// Static tracepoints in map.c under the `hashmap` provider, built in whenever
+// <sys/sdt.h> (systemtap-sdt-dev) is found and HASHMAP_NO_PROBES is not
+// defined. They need nothing at run time: an unattached probe is a single
+// nop, and the arguments that cost anything to work out are only computed
+// while a tracer has set the probe's semaphore (growth is always timed, for
+// hashmap_t's pause summary).
+//
+//   add_entry(key)                      hashmap_add called
+//   add_return(key, success)            hashmap_add returning
+//   get_hit(key, probes)                hashmap_get found the key
+//   get_miss(key, probes)               hashmap_get did not
+//   resize_start(old_cap, new_cap)      growth about to start
+//   resize_end(old_cap, new_cap, ns)    growth done, `ns` it took; fires
+//                                       for failed growth too, see map.h
+//
+// `probes` is the slots a lookup compared, -1 for maps with their own hasher.
+// For example, with bpftrace:
+//
+//   bpftrace -e 'usdt:./app:hashmap:get_hit { @probes = hist(arg1); }'
+//   bpftrace -e 'usdt:./app:hashmap:resize_end { @pause_ns = hist(arg2); }'
+#if defined(__has_include) && !defined(HASHMAP_NO_PROBES)
+#if __has_include(<sys/sdt.h>)
+#define HASHMAP_PROBES
+#endif
+#endif
+
+#ifdef HASHMAP_PROBES
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+// Set by the tracer while the probe is attached, one per probe.
+#define HM_PROBE_SEMAPHORE(name)                                               \
+    __extension__ unsigned short hashmap_##name##_semaphore                    \
+            __attribute__((unused)) __attribute__((section(".probes")))
+#define HM_PROBE_ENABLED(name)                                                 \
+    __builtin_expect(hashmap_##name##_semaphore != 0, 0)
+#define HM_PROBE1(name, a) DTRACE_PROBE1(hashmap, name, a)
+#define HM_PROBE2(name, a, b) DTRACE_PROBE2(hashmap, name, a, b)
+#define HM_PROBE3(name, a, b, c) DTRACE_PROBE3(hashmap, name, a, b, c)
+#else
+#define HM_PROBE_ENABLED(name) 0
+#define HM_PROBE1(name, a) ((void)(a))
+#define HM_PROBE2(name, a, b) ((void)(a), (void)(b))
+#define HM_PROBE3(name, a, b, c) ((void)(a), (void)(b), (void)(c))
+#endif
+
+#endif // !HASHMAP_PROBES_H_SHARED
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
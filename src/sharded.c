@@ -0,0 +1,202 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#define _POSIX_C_SOURCE 200809L // pthread_rwlock_t
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "map.h"
+#include "sharded.h"
+#include "sync.h"
+#include "xxhash.h"
+
+static inline hashmap_shard_t *_shard_for(hashmap_sharded_t *map,
+                                          const char *key)
+{
+    if (map->shard_bits == 0)
+        return map->shards;
+    uint64_t hash = XXH64(key, strlen(key), 0);
+    return map->shards + (hash >> (64 - map->shard_bits));
+}
+
+static inline void _shard_read_lock(hashmap_sharded_t *map,
+                                    hashmap_shard_t *shard)
+{
+    if (map->lock_kind == SHARD_LOCK_RWLOCK)
+        pthread_rwlock_rdlock(&shard->lock.rw);
+    else
+        hm_spin_lock(&shard->lock.spin);
+}
+
+static inline void _shard_write_lock(hashmap_sharded_t *map,
+                                     hashmap_shard_t *shard)
+{
+    if (map->lock_kind == SHARD_LOCK_RWLOCK)
+        pthread_rwlock_wrlock(&shard->lock.rw);
+    else
+        hm_spin_lock(&shard->lock.spin);
+}
+
+static inline void _shard_unlock(hashmap_sharded_t *map,
+                                 hashmap_shard_t *shard)
+{
+    if (map->lock_kind == SHARD_LOCK_RWLOCK)
+        pthread_rwlock_unlock(&shard->lock.rw);
+    else
+        hm_spin_unlock(&shard->lock.spin);
+}
+
+hashmap_sharded_t hashmap_sharded_init(int shards, int capacity,
+                                       double load_factor_pct,
+                                       HM_KEY_HASHER hasher_fn,
+                                       shard_lock_t lock_kind)
+{
+    hashmap_sharded_t map = {0};
+    int bits = 0;
+
+    while ((1 << bits) < shards && bits < 16)
+        bits++;
+    int nshards = 1 << bits;
+    int per_shard = capacity / nshards < 8 ? 8 : capacity / nshards;
+
+    hashmap_shard_t *array = (hashmap_shard_t *)aligned_alloc(
+            HM_CACHE_LINE, nshards * sizeof(hashmap_shard_t));
+    if (array == NULL)
+        return map;
+    memset(array, 0, nshards * sizeof(hashmap_shard_t));
+
+    for (int i = 0; i < nshards; ++i) {
+        if (lock_kind == SHARD_LOCK_RWLOCK)
+            pthread_rwlock_init(&array[i].lock.rw, NULL);
+        else
+            atomic_init(&array[i].lock.spin, 0);
+        array[i].map = hashmap_init(per_shard, load_factor_pct, hasher_fn);
+        if (array[i].map.buckets.array == NULL) {
+            map.shards = array;
+            map.nshards = i + 1;
+            map.lock_kind = lock_kind;
+            hashmap_sharded_free(&map);
+            return map;
+        }
+    }
+
+    map.shards = array;
+    map.nshards = nshards;
+    map.shard_bits = bits;
+    map.lock_kind = lock_kind;
+    return map;
+}
+
+void hashmap_sharded_free(hashmap_sharded_t *map)
+{
+    for (int i = 0; i < map->nshards; ++i) {
+        hashmap_free(&map->shards[i].map);
+        if (map->lock_kind == SHARD_LOCK_RWLOCK)
+            pthread_rwlock_destroy(&map->shards[i].lock.rw);
+    }
+    free(map->shards);
+    map->shards = NULL;
+    map->nshards = map->shard_bits = 0;
+}
+
+bool hashmap_sharded_add(hashmap_sharded_t *map, const char *key,
+                         value_t value)
+{
+    hashmap_shard_t *shard = _shard_for(map, key);
+    _shard_write_lock(map, shard);
+    bool success = hashmap_add(&shard->map, key, value);
+    _shard_unlock(map, shard);
+    return success;
+}
+
+bool hashmap_sharded_upsert(hashmap_sharded_t *map, const char *key,
+                            value_t value)
+{
+    hashmap_shard_t *shard = _shard_for(map, key);
+    _shard_write_lock(map, shard);
+    bool success = hashmap_upsert(&shard->map, key, value);
+    _shard_unlock(map, shard);
+    return success;
+}
+
+bool hashmap_sharded_delete(hashmap_sharded_t *map, const char *key)
+{
+    hashmap_shard_t *shard = _shard_for(map, key);
+    _shard_write_lock(map, shard);
+    bool success = hashmap_delete(&shard->map, key);
+    _shard_unlock(map, shard);
+    return success;
+}
+
+value_t hashmap_sharded_get(hashmap_sharded_t *map, const char *key)
+{
+    hashmap_shard_t *shard = _shard_for(map, key);
+    _shard_read_lock(map, shard);
+    value_t value = hashmap_get(&shard->map, key);
+    _shard_unlock(map, shard);
+    return value;
+}
+
+bool hashmap_sharded_clear(hashmap_sharded_t *map)
+{
+    bool success = true;
+    for (int i = 0; i < map->nshards; ++i) {
+        _shard_write_lock(map, map->shards + i);
+        success = hashmap_clear(&map->shards[i].map) && success;
+        _shard_unlock(map, map->shards + i);
+    }
+    return success;
+}
+
+// Stores `value` into the locked shard's map, where NIL_VAL deletes.
+static bool _shard_store(hashmap_shard_t *shard, const char *key,
+                         value_t value)
+{
+    if (IS_NIL(value))
+        return hashmap_delete(&shard->map, key);
+    return hashmap_upsert(&shard->map, key, value);
+}
+
+bool hashmap_sharded_cas(hashmap_sharded_t *map, const char *key,
+                         value_t expected, value_t desired)
+{
+    hashmap_shard_t *shard = _shard_for(map, key);
+    _shard_write_lock(map, shard);
+    bool success = hashmap_get(&shard->map, key) == expected &&
+                   (expected == desired || _shard_store(shard, key, desired));
+    _shard_unlock(map, shard);
+    return success;
+}
+
+bool hashmap_sharded_fetch_add_number(hashmap_sharded_t *map, const char *key,
+                                      double delta, double *prev)
+{
+    hashmap_shard_t *shard = _shard_for(map, key);
+    _shard_write_lock(map, shard);
+    value_t curr = hashmap_get(&shard->map, key);
+    double number = IS_NIL(curr) ? 0 : _value_to_number(&curr);
+    bool success = (IS_NIL(curr) || IS_NUMBER(curr)) &&
+                   hashmap_upsert(&shard->map, key,
+                                  _number_to_value(number + delta));
+    _shard_unlock(map, shard);
+    if (success && prev != NULL)
+        *prev = number;
+    return success;
+}
+
+value_t hashmap_sharded_exchange(hashmap_sharded_t *map, const char *key,
+                                 value_t value)
+{
+    hashmap_shard_t *shard = _shard_for(map, key);
+    _shard_write_lock(map, shard);
+    value_t prev = hashmap_get(&shard->map, key);
+    if (prev != value)
+        _shard_store(shard, key, value);
+    _shard_unlock(map, shard);
+    return prev;
+}
@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef HASHMAP_SHARDED_H_SHARED
+#define HASHMAP_SHARDED_H_SHARED
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "map.h"
+#include "sync.h"
+#include "value.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//                            Sharded HashMap Typing                          //
+////////////////////////////////////////////////////////////////////////////////
+
+// A sharded map is a power of two number of independent hashmap_t shards, each
+// behind its own lock and padded to a cache line boundary. The shard is picked
+// by the high bits of the key's XXH64 hash, leaving the low bits for the
+// shard's own bucket index, and every shard resizes on its own.
+//
+// pthread_rwlock_t is POSIX.1-2001, so strict ISO C builds (-std=c11) must
+// define _POSIX_C_SOURCE 200809L before their first include to use this header.
+typedef enum shard_lock_t {
+    SHARD_LOCK_SPIN,   // exclusive for every operation, cheapest uncontended
+    SHARD_LOCK_RWLOCK, // shared for gets, scales read-mostly workloads
+} shard_lock_t;
+
+typedef struct hashmap_shard_t {
+    _Alignas(HM_CACHE_LINE) union {
+        hm_spinlock_t spin;
+        pthread_rwlock_t rw;
+    } lock;
+    hashmap_t map;
+} hashmap_shard_t;
+
+typedef struct hashmap_sharded_t {
+    hashmap_shard_t *shards;
+    int nshards, shard_bits;
+    shard_lock_t lock_kind;
+} hashmap_sharded_t;
+
+////////////////////////////////////////////////////////////////////////////////
+//                         Sharded HashMap Life Cycle                         //
+////////////////////////////////////////////////////////////////////////////////
+
+// `shards` is rounded up to a power of two and `capacity` is split evenly
+// between them.
+hashmap_sharded_t hashmap_sharded_init(int shards, int capacity,
+                                       double load_factor_pct,
+                                       HM_KEY_HASHER hasher_fn,
+                                       shard_lock_t lock_kind);
+void hashmap_sharded_free(hashmap_sharded_t *map);
+
+////////////////////////////////////////////////////////////////////////////////
+//                         Sharded HashMap Modifiers                          //
+////////////////////////////////////////////////////////////////////////////////
+
+bool hashmap_sharded_add(hashmap_sharded_t *map, const char *key,
+                         value_t value);
+bool hashmap_sharded_upsert(hashmap_sharded_t *map, const char *key,
+                            value_t value);
+bool hashmap_sharded_delete(hashmap_sharded_t *map, const char *key);
+value_t hashmap_sharded_get(hashmap_sharded_t *map, const char *key);
+bool hashmap_sharded_clear(hashmap_sharded_t *map);
+
+////////////////////////////////////////////////////////////////////////////////
+//                       Sharded HashMap Atomic Updates                       //
+////////////////////////////////////////////////////////////////////////////////
+
+// Read-modify-write under the key's shard lock only, with the same meaning
+// as the hashmap_concurrent_* versions: NIL_VAL stands for a missing key, so
+// a NIL_VAL `expected` inserts and a NIL_VAL `desired` deletes.
+bool hashmap_sharded_cas(hashmap_sharded_t *map, const char *key,
+                         value_t expected, value_t desired);
+bool hashmap_sharded_fetch_add_number(hashmap_sharded_t *map, const char *key,
+                                      double delta, double *prev);
+value_t hashmap_sharded_exchange(hashmap_sharded_t *map, const char *key,
+                                 value_t value);
+
+#endif // !HASHMAP_SHARDED_H_SHARED
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
@@ -0,0 +1,209 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#define _POSIX_C_SOURCE 200809L // fileno, fsync
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "map.h"
+#include "snapshot.h"
+#include "xxhash.h"
+
+// Images are kept at most 3/4 full so in-place probing stays short.
+static uint64_t _snapshot_capacity(uint64_t count)
+{
+    uint64_t capacity = 8;
+    while (capacity * 3 < count * 4)
+        capacity <<= 1;
+    return capacity;
+}
+
+bool hashmap_save(hashmap_t *map, const char *path)
+{
+    bucket_t curr, empty = {0};
+    uint64_t count = 0, blob_size = 0;
+
+    for (int i = 0; i < map->buckets.capacity; ++i) {
+        curr = vector_gpos_type(&map->buckets, bucket_t, i);
+        if (memcmp(&curr, &empty, sizeof(bucket_t)) == 0)
+            continue;
+        count++;
+        blob_size += strlen(curr.key) + 1;
+    }
+    if (blob_size >= SNAPSHOT_EMPTY_SLOT)
+        return false;
+
+    uint64_t capacity = _snapshot_capacity(count), mask = capacity - 1;
+    snapshot_slot_t *slots =
+            (snapshot_slot_t *)malloc(capacity * sizeof(snapshot_slot_t));
+    if (slots == NULL)
+        return false;
+    for (uint64_t i = 0; i < capacity; ++i) {
+        snapshot_slot_t unused = {.key_len = SNAPSHOT_EMPTY_SLOT,
+                                  .value = NIL_VAL};
+        slots[i] = unused;
+    }
+
+    // Key offsets follow bucket order, which is also the order the blob is
+    // streamed out in below.
+    uint32_t offset = 0;
+    for (int i = 0; i < map->buckets.capacity; ++i) {
+        curr = vector_gpos_type(&map->buckets, bucket_t, i);
+        if (memcmp(&curr, &empty, sizeof(bucket_t)) == 0)
+            continue;
+        uint32_t len = (uint32_t)strlen(curr.key);
+        uint64_t hash = XXH64(curr.key, len, 0), idx = hash & mask;
+        while (slots[idx].key_len != SNAPSHOT_EMPTY_SLOT)
+            idx = (idx + 1) & mask;
+        slots[idx].hash = hash;
+        slots[idx].key_off = offset;
+        slots[idx].key_len = len;
+        slots[idx].value = curr.value;
+        offset += len + 1;
+    }
+
+    // The image is written beside `path` and renamed over it once complete,
+    // so a crash mid-save leaves the old image intact and readers that have
+    // it mapped keep their copy.
+    size_t path_len = strlen(path);
+    char *tmp = (char *)malloc(path_len + sizeof(".tmp"));
+    FILE *fp = NULL;
+    if (tmp != NULL) {
+        memcpy(tmp, path, path_len);
+        memcpy(tmp + path_len, ".tmp", sizeof(".tmp"));
+        fp = fopen(tmp, "wb");
+    }
+    if (fp == NULL) {
+        free(tmp);
+        free(slots);
+        return false;
+    }
+
+    snapshot_header_t header = {
+            .magic = SNAPSHOT_MAGIC,
+            .version = SNAPSHOT_VERSION,
+            .slot_size = sizeof(snapshot_slot_t),
+            .count = count,
+            .capacity = capacity,
+            .blob_size = blob_size,
+    };
+
+    XXH64_state_t *xhstate = XXH64_createState();
+    bool success = xhstate != NULL && XXH64_reset(xhstate, 0) == XXH_OK;
+
+    // The header is rewritten once the checksum of everything after it is
+    // known.
+    success = success && fwrite(&header, sizeof(header), 1, fp) == 1;
+    success = success &&
+              fwrite(slots, sizeof(snapshot_slot_t), capacity, fp) == capacity;
+    success = success && XXH64_update(xhstate, slots,
+                                      capacity * sizeof(snapshot_slot_t)) ==
+                                 XXH_OK;
+    for (int i = 0; success && i < map->buckets.capacity; ++i) {
+        curr = vector_gpos_type(&map->buckets, bucket_t, i);
+        if (memcmp(&curr, &empty, sizeof(bucket_t)) == 0)
+            continue;
+        size_t len = strlen(curr.key) + 1;
+        success = fwrite(curr.key, 1, len, fp) == len &&
+                  XXH64_update(xhstate, curr.key, len) == XXH_OK;
+    }
+    if (success) {
+        header.checksum = XXH64_digest(xhstate);
+        success = fseek(fp, 0, SEEK_SET) == 0 &&
+                  fwrite(&header, sizeof(header), 1, fp) == 1;
+    }
+    success = success && fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+
+    if (fclose(fp) != 0)
+        success = false;
+    success = success && rename(tmp, path) == 0;
+    if (xhstate != NULL)
+        XXH64_freeState(xhstate);
+    free(slots);
+    if (!success)
+        unlink(tmp);
+    free(tmp);
+    return success;
+}
+
+hashmap_image_t hashmap_open_mmap(const char *path)
+{
+    hashmap_image_t image = {0};
+    struct stat st;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return image;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(snapshot_header_t)) {
+        close(fd);
+        return image;
+    }
+
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps its own reference to the file
+    if (base == MAP_FAILED)
+        return image;
+
+    const snapshot_header_t *header = (const snapshot_header_t *)base;
+    uint64_t expected = sizeof(snapshot_header_t) +
+                        header->capacity * sizeof(snapshot_slot_t) +
+                        header->blob_size;
+    if (header->magic != SNAPSHOT_MAGIC ||
+        header->version != SNAPSHOT_VERSION ||
+        header->slot_size != sizeof(snapshot_slot_t) ||
+        header->capacity == 0 ||
+        (header->capacity & (header->capacity - 1)) != 0 ||
+        header->capacity > (uint64_t)st.st_size ||
+        expected != (uint64_t)st.st_size) {
+        munmap(base, st.st_size);
+        return image;
+    }
+
+    image.base = base;
+    image.length = st.st_size;
+    image.header = header;
+    image.slots = (const snapshot_slot_t *)(header + 1);
+    image.blob = (const char *)(image.slots + header->capacity);
+    return image;
+}
+
+bool hashmap_image_verify(hashmap_image_t *image)
+{
+    if (image->base == NULL)
+        return false;
+    uint64_t checksum = XXH64(image->slots,
+                              image->length - sizeof(snapshot_header_t), 0);
+    return checksum == image->header->checksum;
+}
+
+void hashmap_image_close(hashmap_image_t *image)
+{
+    if (image->base != NULL)
+        munmap((void *)image->base, image->length);
+    memset(image, 0, sizeof(hashmap_image_t));
+}
+
+value_t hashmap_image_get(hashmap_image_t *image, const char *key)
+{
+    if (image->base == NULL)
+        return NIL_VAL;
+
+    size_t len = strlen(key);
+    uint64_t hash = XXH64(key, len, 0), mask = image->header->capacity - 1;
+    for (uint64_t idx = hash & mask;; idx = (idx + 1) & mask) {
+        const snapshot_slot_t *slot = image->slots + idx;
+        if (slot->key_len == SNAPSHOT_EMPTY_SLOT)
+            return NIL_VAL;
+        if (slot->hash == hash && slot->key_len == len &&
+            memcmp(image->blob + slot->key_off, key, len) == 0)
+            return slot->value;
+    }
+}
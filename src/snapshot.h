@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef HASHMAP_SNAPSHOT_H_SHARED
+#define HASHMAP_SNAPSHOT_H_SHARED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "map.h"
+#include "value.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//                          HashMap Snapshot Format                           //
+////////////////////////////////////////////////////////////////////////////////
+
+// On-disk image layout (native byte order, every section 8 byte aligned):
+//
+//   [snapshot_header_t][snapshot_slot_t * capacity][key blob]
+//
+// The slot array is its own open-addressing table (linear probing over a power
+// of two capacity) so an mmap'ed image is queried in place. Keys live in the
+// blob as NUL-terminated strings addressed by offsets relative to the blob
+// start, which keeps the image position independent. OBJ_VAL values are
+// written as-is and are only meaningful to the process that saved them.
+#define SNAPSHOT_MAGIC 0x50414e534d48ULL // "HMSNAP" little-endian
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_EMPTY_SLOT UINT32_MAX
+
+typedef struct snapshot_header_t {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t slot_size; // sizeof(snapshot_slot_t) when written
+    uint64_t count;
+    uint64_t capacity;
+    uint64_t blob_size;
+    uint64_t checksum; // XXH64 over the slot array and key blob
+    uint64_t reserved[2];
+} snapshot_header_t;
+
+typedef struct snapshot_slot_t {
+    uint64_t hash;
+    uint32_t key_off; // relative to the blob start
+    uint32_t key_len; // SNAPSHOT_EMPTY_SLOT when the slot is unused
+    value_t value;
+} snapshot_slot_t;
+
+typedef struct hashmap_image_t {
+    const void *base;
+    size_t length;
+    const snapshot_header_t *header;
+    const snapshot_slot_t *slots;
+    const char *blob;
+} hashmap_image_t;
+
+////////////////////////////////////////////////////////////////////////////////
+//                          HashMap Snapshot Life Cycle                       //
+////////////////////////////////////////////////////////////////////////////////
+
+bool hashmap_save(hashmap_t *map, const char *path);
+
+// Maps the image read-only; only the header is validated so opening is O(1)
+// regardless of the image size, call hashmap_image_verify to check the
+// checksum of the whole image.
+hashmap_image_t hashmap_open_mmap(const char *path);
+bool hashmap_image_verify(hashmap_image_t *image);
+void hashmap_image_close(hashmap_image_t *image);
+
+////////////////////////////////////////////////////////////////////////////////
+//                           HashMap Snapshot Lookups                         //
+////////////////////////////////////////////////////////////////////////////////
+
+// Same semantics as hashmap_get - NIL_VAL is returned for missing keys.
+value_t hashmap_image_get(hashmap_image_t *image, const char *key);
+
+#endif // !HASHMAP_SNAPSHOT_H_SHARED
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
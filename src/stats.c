@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "map.h"
+#include "stats.h"
+#include "xxhash.h"
+
+typedef struct stats_walk_t {
+    hashmap_stats_t *out;
+    uint64_t distances;   // summed over every entry walked
+    uint64_t miss_probes; // summed over every slot walked
+} stats_walk_t;
+
+static void _stats_entry(hashmap_t *map, stats_walk_t *walk, int slot)
+{
+    const char *key = map->buckets.array[slot].key;
+    uint64_t capacity = (uint64_t)map->buckets.capacity;
+    uint64_t home = XXH64(key, strlen(key), 0) % capacity;
+    int distance = (int)(((uint64_t)slot + capacity - home) % capacity);
+
+    hashmap_stats_t *out = walk->out;
+    int bucket = distance < STATS_PROBE_BUCKETS ? distance
+                                                : STATS_PROBE_BUCKETS - 1;
+    out->entries++;
+    out->probe_histogram[bucket]++;
+    if (distance > out->probe_max)
+        out->probe_max = distance;
+    walk->distances += (uint64_t)distance;
+}
+
+// A miss starting at the j-th of a cluster's `run` slots probes the rest of
+// it and the empty slot after.
+static void _stats_cluster(stats_walk_t *walk, int run)
+{
+    if (run > walk->out->longest_cluster)
+        walk->out->longest_cluster = run;
+    walk->miss_probes += (uint64_t)run * (run + 1) / 2 + run;
+}
+
+static bool _stats_walk(hashmap_t *map, hashmap_stats_t *out, int every)
+{
+    if (map->hasher_fn != _default_hasher || every < 1)
+        return false;
+    memset(out, 0, sizeof(hashmap_stats_t));
+    out->size = map->buckets.size;
+    out->capacity = map->buckets.capacity;
+    if (out->capacity > 0)
+        out->load_factor = (double)out->size / (double)out->capacity;
+
+    int capacity = map->buckets.capacity;
+    bucket_t *slots = map->buckets.array;
+    int start = 0;
+    while (start < capacity && slots[start].key != NULL)
+        start++;
+    if (start == capacity)
+        start = 0; // full, the whole table is one cluster
+
+    stats_walk_t walk = {.out = out};
+    int64_t stride = (int64_t)STATS_BLOCK_SLOTS * every, done = 0;
+    for (int64_t block = 0; block < capacity; block += stride) {
+        int64_t offset = block > done ? block : done;
+        int64_t end = block + STATS_BLOCK_SLOTS;
+        // Skip what is left of a cluster begun before the block, unwalked.
+        if (offset > done && slots[(start + offset - 1) % capacity].key != NULL)
+            while (offset < end && offset < capacity &&
+                   slots[(start + offset) % capacity].key != NULL)
+                offset++;
+
+        int run = 0;
+        for (; offset < capacity && (offset < end || run > 0); ++offset) {
+            int slot = (int)((start + offset) % capacity);
+            out->examined++;
+            if (slots[slot].key != NULL) {
+                _stats_entry(map, &walk, slot);
+                run++;
+                continue;
+            }
+            _stats_cluster(&walk, run);
+            walk.miss_probes++;
+            run = 0;
+        }
+        if (run > 0)
+            _stats_cluster(&walk, run);
+        done = offset;
+    }
+
+    if (out->entries > 0) {
+        out->probe_mean = (double)walk.distances / (double)out->entries;
+        uint64_t seen = 0, rank = (out->entries * 99 + 99) / 100;
+        while (seen + out->probe_histogram[out->probe_p99] < rank)
+            seen += out->probe_histogram[out->probe_p99++];
+    }
+    if (out->examined > 0)
+        out->expected_miss_probes =
+                (double)walk.miss_probes / (double)out->examined;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                  Stats                                     //
+////////////////////////////////////////////////////////////////////////////////
+
+bool hashmap_stats(hashmap_t *map, hashmap_stats_t *out)
+{
+    return _stats_walk(map, out, 1);
+}
+
+bool hashmap_stats_sampled(hashmap_t *map, hashmap_stats_t *out, int every)
+{
+    return _stats_walk(map, out, every);
+}
@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef HASHMAP_STATS_H_SHARED
+#define HASHMAP_STATS_H_SHARED
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "map.h"
+#include "value.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//                               Stats Typing                                 //
+////////////////////////////////////////////////////////////////////////////////
+
+// How well the keys are spread over a `_default_hasher` table. An entry's
+// probe distance is how many slots past its home bucket it lives, a cluster
+// is a run of occupied slots between two empty ones. The table is walked in
+// blocks of STATS_BLOCK_SLOTS starting from an empty slot, so no cluster is
+// cut in two; the sampled mode walks only every n-th block, finishing the
+// cluster a block ends in and skipping the one the next block starts in.
+#define STATS_PROBE_BUCKETS 64 // the last bucket also counts longer probes
+#define STATS_BLOCK_SLOTS 4096
+
+typedef struct hashmap_stats_t {
+    int size, capacity;
+    double load_factor; // size / capacity
+    int examined;       // slots walked, all of them unless sampled
+    uint64_t entries;   // entries walked
+    uint64_t probe_histogram[STATS_PROBE_BUCKETS]; // entries by distance
+    double probe_mean;
+    int probe_max;
+    int probe_p99;
+    int longest_cluster;
+    // Deletes shift the rest of the cluster back instead of leaving
+    // tombstones, so this is always 0 for a hashmap_t.
+    int tombstones;
+    // Slots a lookup of an absent key probes on average, the empty slot
+    // ending it included.
+    double expected_miss_probes;
+} hashmap_stats_t;
+
+////////////////////////////////////////////////////////////////////////////////
+//                                  Stats                                     //
+////////////////////////////////////////////////////////////////////////////////
+
+// Walks the whole table once. Fails for maps with another hasher, whose
+// home buckets are unknown.
+bool hashmap_stats(hashmap_t *map, hashmap_stats_t *out);
+// As hashmap_stats, walking only one block in every `every`. `size`,
+// `capacity` and `load_factor` stay exact, the rest describe the sample.
+bool hashmap_stats_sampled(hashmap_t *map, hashmap_stats_t *out, int every);
+
+#endif // !HASHMAP_STATS_H_SHARED
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
@@ -0,0 +1,197 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "map.h"
+#include "stream.h"
+#include "xxhash.h"
+
+#define STREAM_RECORD_HEADER (sizeof(uint32_t) + sizeof(value_t))
+
+// Refuse chunks larger than this when loading, a corrupt length field would
+// otherwise turn into an arbitrarily large allocation.
+#define STREAM_MAX_CHUNK (1u << 30)
+
+static bool _stream_flush(HM_STREAM_WRITE write_fn, void *ctx, char *buf,
+                          uint32_t bytes, uint32_t records)
+{
+    stream_chunk_t chunk = {
+            .records = records,
+            .bytes = bytes,
+            .checksum = XXH3_64bits(buf, bytes),
+    };
+    if (write_fn(ctx, &chunk, sizeof(chunk)) != sizeof(chunk))
+        return false;
+    return bytes == 0 || write_fn(ctx, buf, bytes) == bytes;
+}
+
+bool hashmap_dump_stream(hashmap_t *map, HM_STREAM_WRITE write_fn, void *ctx)
+{
+    bucket_t curr, empty = {0};
+    uint64_t count = 0;
+
+    for (int i = 0; i < map->buckets.capacity; ++i) {
+        curr = vector_gpos_type(&map->buckets, bucket_t, i);
+        if (memcmp(&curr, &empty, sizeof(bucket_t)) != 0)
+            count++;
+    }
+
+    stream_header_t header = {
+            .magic = STREAM_MAGIC,
+            .version = STREAM_VERSION,
+            .count = count,
+            .load_factor_pct = map->buckets.load_factor_pct,
+    };
+    if (write_fn(ctx, &header, sizeof(header)) != sizeof(header))
+        return false;
+
+    size_t cap = STREAM_CHUNK_SIZE;
+    char *buf = (char *)malloc(cap);
+    if (buf == NULL)
+        return false;
+
+    bool success = true;
+    uint32_t bytes = 0, records = 0;
+    for (int i = 0; success && i < map->buckets.capacity; ++i) {
+        curr = vector_gpos_type(&map->buckets, bucket_t, i);
+        if (memcmp(&curr, &empty, sizeof(bucket_t)) == 0)
+            continue;
+
+        uint32_t len = (uint32_t)strlen(curr.key);
+        size_t need = STREAM_RECORD_HEADER + len;
+        if (need > STREAM_MAX_CHUNK) {
+            success = false;
+            break;
+        }
+        if (bytes + need > cap) {
+            if (records > 0) {
+                success = _stream_flush(write_fn, ctx, buf, bytes, records);
+                bytes = records = 0;
+            }
+            // Oversized keys get a chunk of their own.
+            if (success && need > cap) {
+                char *grown = (char *)realloc(buf, need);
+                success = grown != NULL;
+                if (success) {
+                    buf = grown;
+                    cap = need;
+                }
+            }
+            if (!success)
+                break;
+        }
+
+        memcpy(buf + bytes, &len, sizeof(uint32_t));
+        memcpy(buf + bytes + sizeof(uint32_t), &curr.value, sizeof(value_t));
+        memcpy(buf + bytes + STREAM_RECORD_HEADER, curr.key, len);
+        bytes += need;
+        records++;
+    }
+
+    if (success && records > 0)
+        success = _stream_flush(write_fn, ctx, buf, bytes, records);
+    if (success) // terminating empty chunk
+        success = _stream_flush(write_fn, ctx, buf, 0, 0);
+
+    free(buf);
+    return success;
+}
+
+// Inserts a verified chunk's records as one batch; nothing from a chunk is
+// applied until its checksum has matched.
+static bool _stream_apply(hashmap_t *map, const char *buf, uint32_t bytes,
+                          uint32_t records, char **scratch,
+                          size_t *scratch_cap)
+{
+    uint32_t off = 0;
+    for (uint32_t r = 0; r < records; ++r) {
+        uint32_t len;
+        value_t value;
+        if (bytes - off < STREAM_RECORD_HEADER)
+            return false;
+        memcpy(&len, buf + off, sizeof(uint32_t));
+        memcpy(&value, buf + off + sizeof(uint32_t), sizeof(value_t));
+        off += STREAM_RECORD_HEADER;
+        if (bytes - off < len)
+            return false;
+
+        if (len + 1 > *scratch_cap) {
+            char *grown = (char *)realloc(*scratch, len + 1);
+            if (grown == NULL)
+                return false;
+            *scratch = grown;
+            *scratch_cap = len + 1;
+        }
+        memcpy(*scratch, buf + off, len);
+        (*scratch)[len] = '\0';
+        off += len;
+
+        // the loaded map owns its keys, so the scratch copy is duplicated
+        if (!hashmap_add(map, *scratch, value))
+            return false;
+    }
+    return off == bytes;
+}
+
+hashmap_t hashmap_load_stream(HM_STREAM_READ read_fn, void *ctx)
+{
+    hashmap_t map = {0}, failed = {0};
+    stream_header_t header;
+
+    if (read_fn(ctx, &header, sizeof(header)) != sizeof(header) ||
+        header.magic != STREAM_MAGIC || header.version != STREAM_VERSION ||
+        !(header.load_factor_pct > 0.0 && header.load_factor_pct <= 1.0))
+        return failed;
+
+    // Presize from the header so loading never has to rehash.
+    double want = (double)(header.count + 1) / header.load_factor_pct + 1.0;
+    if (want > (double)INT32_MAX / 2)
+        return failed;
+    int capacity = want < 8.0 ? 8 : (int)want;
+    map = hashmap_init(capacity, header.load_factor_pct, _default_hasher);
+    if (map.buckets.array == NULL)
+        return failed;
+    map.owns_keys = true;
+
+    size_t cap = STREAM_CHUNK_SIZE, scratch_cap = 0;
+    char *buf = (char *)malloc(cap), *scratch = NULL;
+    bool success = buf != NULL;
+    while (success) {
+        stream_chunk_t chunk;
+        if (read_fn(ctx, &chunk, sizeof(chunk)) != sizeof(chunk) ||
+            chunk.bytes > STREAM_MAX_CHUNK) {
+            success = false;
+            break;
+        }
+        if (chunk.records == 0) {
+            success = chunk.bytes == 0;
+            break;
+        }
+        if (chunk.bytes > cap) {
+            char *grown = (char *)realloc(buf, chunk.bytes);
+            if (grown == NULL) {
+                success = false;
+                break;
+            }
+            buf = grown;
+            cap = chunk.bytes;
+        }
+        success = read_fn(ctx, buf, chunk.bytes) == chunk.bytes &&
+                  XXH3_64bits(buf, chunk.bytes) == chunk.checksum &&
+                  _stream_apply(&map, buf, chunk.bytes, chunk.records,
+                                &scratch, &scratch_cap);
+    }
+
+    free(buf);
+    free(scratch);
+    if (!success) {
+        hashmap_free(&map);
+        return failed;
+    }
+    return map;
+}
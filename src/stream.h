@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef HASHMAP_STREAM_H_SHARED
+#define HASHMAP_STREAM_H_SHARED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "map.h"
+#include "value.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//                           HashMap Stream Format                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// A stream is a stream_header_t followed by chunks, each a stream_chunk_t and
+// `bytes` of packed records: [uint32 key_len][value_t value][key bytes]. Every
+// chunk carries the XXH3 checksum of its payload and a chunk with no records
+// terminates the stream. Chunks are bounded by STREAM_CHUNK_SIZE (unless a
+// single key is larger) so neither side holds more than one chunk in memory.
+#define STREAM_MAGIC 0x4d5254534d48ULL // "HMSTRM" little-endian
+#define STREAM_VERSION 1
+#define STREAM_CHUNK_SIZE (64 * 1024)
+
+typedef struct stream_header_t {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t count; // live entries when the dump started, used to presize
+    double load_factor_pct;
+} stream_header_t;
+
+typedef struct stream_chunk_t {
+    uint32_t records;
+    uint32_t bytes;
+    uint64_t checksum;
+} stream_chunk_t;
+
+// Both callbacks return the number of bytes transferred, anything short of
+// `len` is treated as an error (or the end of the stream for the reader).
+typedef size_t (*HM_STREAM_WRITE)(void *ctx, const void *buf, size_t len);
+typedef size_t (*HM_STREAM_READ)(void *ctx, void *buf, size_t len);
+
+////////////////////////////////////////////////////////////////////////////////
+//                          HashMap Stream Snapshots                          //
+////////////////////////////////////////////////////////////////////////////////
+
+bool hashmap_dump_stream(hashmap_t *map, HM_STREAM_WRITE write_fn, void *ctx);
+
+// The returned map owns copies of every key (map.owns_keys is set); on a
+// short read, bad checksum or allocation failure a zeroed map is returned.
+hashmap_t hashmap_load_stream(HM_STREAM_READ read_fn, void *ctx);
+
+#endif // !HASHMAP_STREAM_H_SHARED
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
@@ -0,0 +1,320 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "swmr.h"
+#include "sync.h"
+#include "xxhash.h"
+
+static swmr_table_t *_swmr_table_new(int64_t capacity)
+{
+    size_t bytes = sizeof(swmr_table_t) + capacity * sizeof(swmr_slot_t);
+    bytes = (bytes + HM_CACHE_LINE - 1) & ~(size_t)(HM_CACHE_LINE - 1);
+    swmr_table_t *table = (swmr_table_t *)aligned_alloc(HM_CACHE_LINE, bytes);
+    if (table == NULL)
+        return NULL;
+    table->capacity = capacity;
+    atomic_init(&table->seq, 0);
+    for (int64_t i = 0; i < capacity; ++i) {
+        atomic_init(&table->slots[i].key, NULL);
+        atomic_init(&table->slots[i].value, NIL_VAL);
+    }
+    return table;
+}
+
+static inline uint64_t _swmr_hash(const char *key)
+{
+    return XXH64(key, strlen(key), 0);
+}
+
+// Writer side probe, returns the slot holding `key` or the empty slot that
+// ends its probe sequence.
+static int64_t _swmr_find(swmr_table_t *table, const char *key, uint64_t hash)
+{
+    uint64_t mask = table->capacity - 1, i = hash & mask;
+    for (;;) {
+        const char *stored = atomic_load_explicit(&table->slots[i].key,
+                                                  memory_order_relaxed);
+        if (stored == NULL || strcmp(stored, key) == 0)
+            return i;
+        i = (i + 1) & mask;
+    }
+}
+
+static inline void _swmr_store(swmr_table_t *table, int64_t i, const char *key,
+                               value_t value)
+{
+    atomic_store_explicit(&table->slots[i].value, value, memory_order_relaxed);
+    atomic_store_explicit(&table->slots[i].key, key, memory_order_release);
+}
+
+static void _swmr_reclaim(hashmap_swmr_t *map)
+{
+    uint64_t oldest = UINT64_MAX;
+    for (int i = 0; i < SWMR_MAX_READERS; ++i) {
+        uint64_t epoch = atomic_load(&map->readers[i].epoch);
+        if (epoch != 0 && epoch < oldest)
+            oldest = epoch;
+    }
+
+    swmr_retired_t **link = &map->retired;
+    while (*link != NULL) {
+        swmr_retired_t *curr = *link;
+        if (curr->epoch <= oldest) {
+            *link = curr->next;
+            free(curr->table);
+            free(curr);
+        } else {
+            link = &curr->next;
+        }
+    }
+}
+
+static bool _swmr_grow(hashmap_swmr_t *map)
+{
+    swmr_table_t *old = atomic_load_explicit(&map->table, memory_order_relaxed);
+    swmr_table_t *table = _swmr_table_new(old->capacity * 2);
+    swmr_retired_t *retired =
+            (swmr_retired_t *)calloc(1, sizeof(swmr_retired_t));
+    if (table == NULL || retired == NULL) {
+        free(table);
+        free(retired);
+        return false;
+    }
+
+    for (int64_t i = 0; i < old->capacity; ++i) {
+        const char *key = atomic_load_explicit(&old->slots[i].key,
+                                               memory_order_relaxed);
+        if (key == NULL)
+            continue;
+        value_t value = atomic_load_explicit(&old->slots[i].value,
+                                             memory_order_relaxed);
+        _swmr_store(table, _swmr_find(table, key, _swmr_hash(key)), key, value);
+    }
+
+    // Publish before bumping the epoch, any reader that announces the new
+    // epoch is then guaranteed to load the new table.
+    atomic_store(&map->table, table);
+    retired->table = old;
+    retired->epoch = atomic_fetch_add(&map->epoch, 1) + 1;
+    retired->next = map->retired;
+    map->retired = retired;
+    _swmr_reclaim(map);
+    return true;
+}
+
+hashmap_swmr_t hashmap_swmr_init(int capacity, double load_factor_pct)
+{
+    hashmap_swmr_t map = {0};
+    int64_t size = 8;
+    while (size < capacity)
+        size <<= 1;
+
+    map.readers = (swmr_reader_t *)aligned_alloc(
+            HM_CACHE_LINE, SWMR_MAX_READERS * sizeof(swmr_reader_t));
+    swmr_table_t *table = _swmr_table_new(size);
+    if (map.readers == NULL || table == NULL) {
+        free(map.readers);
+        free(table);
+        map.readers = NULL;
+        return map;
+    }
+    for (int i = 0; i < SWMR_MAX_READERS; ++i) {
+        atomic_init(&map.readers[i].epoch, 0);
+        atomic_init(&map.readers[i].in_use, false);
+    }
+    atomic_init(&map.table, table);
+    atomic_init(&map.epoch, 1); // 0 marks an idle reader
+    map.load_factor_pct = load_factor_pct;
+    return map;
+}
+
+void hashmap_swmr_free(hashmap_swmr_t *map)
+{
+    while (map->retired != NULL) {
+        swmr_retired_t *next = map->retired->next;
+        free(map->retired->table);
+        free(map->retired);
+        map->retired = next;
+    }
+    free(atomic_load(&map->table));
+    free(map->readers);
+    atomic_store(&map->table, NULL);
+    map->readers = NULL;
+    map->size = 0;
+}
+
+swmr_reader_t *hashmap_swmr_register(hashmap_swmr_t *map)
+{
+    for (int i = 0; i < SWMR_MAX_READERS; ++i) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&map->readers[i].in_use, &expected,
+                                           true))
+            return map->readers + i;
+    }
+    return NULL;
+}
+
+void hashmap_swmr_unregister(hashmap_swmr_t *map, swmr_reader_t *reader)
+{
+    atomic_store(&reader->epoch, 0);
+    atomic_store(&reader->in_use, false);
+}
+
+value_t hashmap_swmr_get(hashmap_swmr_t *map, swmr_reader_t *reader,
+                         const char *key)
+{
+    uint64_t hash = _swmr_hash(key);
+    value_t value;
+
+    // Announce the epoch before loading the table so the writer won't free
+    // whatever table is loaded below while it is being read.
+    atomic_store(&reader->epoch, atomic_load(&map->epoch));
+    swmr_table_t *table = atomic_load(&map->table);
+    uint64_t mask = table->capacity - 1;
+
+    for (;;) {
+        uint64_t seq = atomic_load_explicit(&table->seq, memory_order_acquire);
+        if (seq & 1) {
+            hm_cpu_relax();
+            continue;
+        }
+
+        value = NIL_VAL;
+        uint64_t i = hash & mask;
+        for (int64_t n = 0; n < table->capacity; ++n, i = (i + 1) & mask) {
+            const char *stored = atomic_load_explicit(&table->slots[i].key,
+                                                      memory_order_acquire);
+            if (stored == NULL)
+                break;
+            if (strcmp(stored, key) == 0) {
+                value = atomic_load_explicit(&table->slots[i].value,
+                                             memory_order_acquire);
+                break;
+            }
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&table->seq, memory_order_relaxed) == seq)
+            break;
+    }
+
+    atomic_store_explicit(&reader->epoch, 0, memory_order_release);
+    return value;
+}
+
+bool hashmap_swmr_add(hashmap_swmr_t *map, const char *key, value_t value)
+{
+    swmr_table_t *table =
+            atomic_load_explicit(&map->table, memory_order_relaxed);
+    uint64_t hash = _swmr_hash(key);
+    int64_t i = _swmr_find(table, key, hash);
+
+    if (atomic_load_explicit(&table->slots[i].key, memory_order_relaxed) !=
+        NULL) {
+        atomic_store_explicit(&table->slots[i].value, value,
+                              memory_order_release);
+        return true;
+    }
+
+    if ((double)(map->size + 1) >
+        (double)table->capacity * map->load_factor_pct) {
+        if (!_swmr_grow(map))
+            return false;
+        table = atomic_load_explicit(&map->table, memory_order_relaxed);
+        i = _swmr_find(table, key, hash);
+    }
+    _swmr_store(table, i, key, value);
+    map->size++;
+    return true;
+}
+
+bool hashmap_swmr_upsert(hashmap_swmr_t *map, const char *key, value_t value)
+{
+    return hashmap_swmr_add(map, key, value);
+}
+
+bool hashmap_swmr_delete(hashmap_swmr_t *map, const char *key)
+{
+    swmr_table_t *table =
+            atomic_load_explicit(&map->table, memory_order_relaxed);
+    uint64_t mask = table->capacity - 1;
+    int64_t i = _swmr_find(table, key, _swmr_hash(key));
+    if (atomic_load_explicit(&table->slots[i].key, memory_order_relaxed) ==
+        NULL)
+        return false;
+
+    uint64_t seq = atomic_load_explicit(&table->seq, memory_order_relaxed);
+    atomic_store_explicit(&table->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    // Backward shift deletion, pull every later member of the cluster whose
+    // home slot is at or before the hole back into it.
+    int64_t j = i;
+    for (;;) {
+        atomic_store_explicit(&table->slots[i].key, NULL, memory_order_relaxed);
+        atomic_store_explicit(&table->slots[i].value, NIL_VAL,
+                              memory_order_relaxed);
+        const char *moved;
+        for (;;) {
+            j = (j + 1) & mask;
+            moved = atomic_load_explicit(&table->slots[j].key,
+                                         memory_order_relaxed);
+            if (moved == NULL)
+                break;
+            uint64_t home = _swmr_hash(moved) & mask;
+            if (((j - home) & mask) >= ((j - i) & mask))
+                break;
+        }
+        if (moved == NULL)
+            break;
+        value_t value = atomic_load_explicit(&table->slots[j].value,
+                                             memory_order_relaxed);
+        atomic_store_explicit(&table->slots[i].value, value,
+                              memory_order_relaxed);
+        atomic_store_explicit(&table->slots[i].key, moved,
+                              memory_order_relaxed);
+        i = j;
+    }
+
+    atomic_store_explicit(&table->seq, seq + 2, memory_order_release);
+    map->size--;
+    return true;
+}
+
+bool hashmap_swmr_clear(hashmap_swmr_t *map)
+{
+    swmr_table_t *table =
+            atomic_load_explicit(&map->table, memory_order_relaxed);
+    uint64_t seq = atomic_load_explicit(&table->seq, memory_order_relaxed);
+    atomic_store_explicit(&table->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for (int64_t i = 0; i < table->capacity; ++i) {
+        atomic_store_explicit(&table->slots[i].key, NULL, memory_order_relaxed);
+        atomic_store_explicit(&table->slots[i].value, NIL_VAL,
+                              memory_order_relaxed);
+    }
+    atomic_store_explicit(&table->seq, seq + 2, memory_order_release);
+    map->size = 0;
+    return true;
+}
+
+void hashmap_swmr_synchronize(hashmap_swmr_t *map)
+{
+    uint64_t epoch = atomic_fetch_add(&map->epoch, 1) + 1;
+    for (int i = 0; i < SWMR_MAX_READERS; ++i) {
+        for (;;) {
+            uint64_t seen = atomic_load(&map->readers[i].epoch);
+            if (seen == 0 || seen >= epoch)
+                break;
+            hm_cpu_relax();
+        }
+    }
+    _swmr_reclaim(map);
+}
@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef HASHMAP_SWMR_H_SHARED
+#define HASHMAP_SWMR_H_SHARED
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sync.h"
+#include "value.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//                  Single-Writer/Multi-Reader HashMap Typing                 //
+////////////////////////////////////////////////////////////////////////////////
+
+// One writer thread mutates the map while any number of registered readers
+// look keys up without taking a lock or writing to shared memory:
+//
+// - inserts fill an empty slot (value first, then key) and updates are single
+//   atomic stores, neither needs any coordination with readers,
+// - deletes re-house the rest of the probe cluster inside a seqlock write
+//   section, readers that overlap one simply retry,
+// - growth builds a whole new table and atomically publishes it, the old one
+//   is retired and freed once every reader has moved past it.
+//
+// Readers only ever write their own cache-line padded epoch slot.
+#define SWMR_MAX_READERS 128
+
+typedef struct swmr_slot_t {
+    _Atomic(const char *) key;
+    _Atomic(value_t) value;
+} swmr_slot_t;
+
+typedef struct swmr_table_t {
+    int64_t capacity; // power of two
+    _Alignas(HM_CACHE_LINE) _Atomic uint64_t seq; // odd while slots move
+    _Alignas(HM_CACHE_LINE) swmr_slot_t slots[];
+} swmr_table_t;
+
+typedef struct swmr_reader_t {
+    _Alignas(HM_CACHE_LINE) _Atomic uint64_t epoch; // 0 while not reading
+    _Atomic bool in_use;
+} swmr_reader_t;
+
+typedef struct swmr_retired_t {
+    swmr_table_t *table;
+    uint64_t epoch; // readers at or past this epoch can't see the table
+    struct swmr_retired_t *next;
+} swmr_retired_t;
+
+typedef struct hashmap_swmr_t {
+    _Atomic(swmr_table_t *) table;
+    _Atomic uint64_t epoch;
+    swmr_reader_t *readers; // SWMR_MAX_READERS slots
+    swmr_retired_t *retired; // writer only
+    int64_t size;            // writer only
+    double load_factor_pct;
+} hashmap_swmr_t;
+
+////////////////////////////////////////////////////////////////////////////////
+//                     SWMR HashMap Life Cycle and Readers                    //
+////////////////////////////////////////////////////////////////////////////////
+
+hashmap_swmr_t hashmap_swmr_init(int capacity, double load_factor_pct);
+void hashmap_swmr_free(hashmap_swmr_t *map);
+
+// Every reader thread registers once and passes its handle to each get; NULL
+// is returned when all SWMR_MAX_READERS slots are taken.
+swmr_reader_t *hashmap_swmr_register(hashmap_swmr_t *map);
+void hashmap_swmr_unregister(hashmap_swmr_t *map, swmr_reader_t *reader);
+
+value_t hashmap_swmr_get(hashmap_swmr_t *map, swmr_reader_t *reader,
+                         const char *key);
+
+////////////////////////////////////////////////////////////////////////////////
+//                      SWMR HashMap Modifiers (writer only)                  //
+////////////////////////////////////////////////////////////////////////////////
+
+bool hashmap_swmr_add(hashmap_swmr_t *map, const char *key, value_t value);
+bool hashmap_swmr_upsert(hashmap_swmr_t *map, const char *key, value_t value);
+bool hashmap_swmr_delete(hashmap_swmr_t *map, const char *key);
+bool hashmap_swmr_clear(hashmap_swmr_t *map);
+
+// Waits until no reader can still hold a key (or value) removed before the
+// call, after which deleted keys may be freed. Also frees retired tables.
+void hashmap_swmr_synchronize(hashmap_swmr_t *map);
+
+#endif // !HASHMAP_SWMR_H_SHARED
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef HASHMAP_SYNC_H
+#define HASHMAP_SYNC_H
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+////////////////////////////////////////////////////////////////////////////////
+//                         Synchronisation Primitives                         //
+////////////////////////////////////////////////////////////////////////////////
+
+// Size every independently written piece of shared state is padded out to, so
+// threads working on neighbouring locks/counters never share a cache line.
+#define HM_CACHE_LINE 64
+
+static inline void hm_cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// Empty polls a waiting thread spins through before yielding its core.
+#define HM_IDLE_SPINS 256
+
+// Spins for a while before yielding, so an oversubscribed core still lets
+// the thread being waited on run. `idle` is the caller's poll counter.
+static inline void hm_backoff(int *idle)
+{
+    if (++*idle < HM_IDLE_SPINS) {
+        hm_cpu_relax();
+    } else {
+        *idle = 0;
+        sched_yield();
+    }
+}
+
+// Test-and-test-and-set spinlock, waiters spin on a plain load so the line
+// stays shared until the holder releases it.
+typedef _Atomic int hm_spinlock_t;
+
+static inline void hm_spin_lock(hm_spinlock_t *lock)
+{
+    for (;;) {
+        if (!atomic_exchange_explicit(lock, 1, memory_order_acquire))
+            return;
+        while (atomic_load_explicit(lock, memory_order_relaxed))
+            hm_cpu_relax();
+    }
+}
+
+static inline bool hm_spin_trylock(hm_spinlock_t *lock)
+{
+    return !atomic_load_explicit(lock, memory_order_relaxed) &&
+           !atomic_exchange_explicit(lock, 1, memory_order_acquire);
+}
+
+static inline void hm_spin_unlock(hm_spinlock_t *lock)
+{
+    atomic_store_explicit(lock, 0, memory_order_release);
+}
+
+#endif /* ifndef HASHMAP_SYNC_H */
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
@@ -7,6 +7,7 @@ extern "C" {
 #endif /* ifdef __cplusplus */
 
 #ifndef GENERIC_VALUES_H
+#define GENERIC_VALUES_H
 
 #include <stdint.h>
 #include <string.h>
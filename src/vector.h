@@ -7,6 +7,7 @@ extern "C" {
 #endif
 
 #ifndef GENERIC_VECTOR_H
+#define GENERIC_VECTOR_H
 
 #include <checkint.h>
 #include <math.h>
@@ -121,8 +122,9 @@ extern "C" {
                 vector_init_type(T, ((vector_##T *)vec)->capacity,             \
                                  ((vector_##T *)vec)->load_factor_pct);        \
         dup.size = ((vector_##T *)vec)->size;                                  \
-        memcpy(dup.array, ((vector_##T *)vec)->array,                          \
-               ((vector_##T *)vec)->capacity * sizeof(T));                     \
+        if (dup.array != NULL)                                                 \
+            memcpy(dup.array, ((vector_##T *)vec)->array,                      \
+                   ((vector_##T *)vec)->capacity * sizeof(T));                 \
         dup;                                                                   \
     })
 
@@ -156,6 +158,7 @@ extern "C" {
             int len = x > y ? y : x;                                           \
             memcpy(new_array, (T *)((vector_##T *)vec)->array,                 \
                    len * sizeof(T));                                           \
+            free((T *)((vector_##T *)vec)->array);                             \
             ((vector_##T *)vec)->array = new_array;                            \
             ((vector_##T *)vec)->capacity = new_cap;                           \
         }                                                                      \
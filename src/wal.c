@@ -0,0 +1,425 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#define _POSIX_C_SOURCE 200809L // fsync, ftruncate
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "map.h"
+#include "wal.h"
+#include "xxhash.h"
+
+#define WAL_CHECKED_OFFSET sizeof(uint64_t)
+
+// Recovery presizes from a HyperLogLog sketch of the distinct keys inserted
+// since the log's last clear, taken during the validation scan, so repeated
+// upserts of a key count once. 2^WAL_HLL_BITS registers estimate to within
+// about 1.6%, and WAL_HLL_SLACK percent of headroom covers that error.
+#define WAL_HLL_BITS 12
+#define WAL_HLL_REGISTERS (1 << WAL_HLL_BITS)
+#define WAL_HLL_SLACK 5
+
+typedef struct wal_keys_t {
+    uint64_t inserts; // upper bound for small logs the sketch overcounts
+    uint8_t registers[WAL_HLL_REGISTERS];
+} wal_keys_t;
+
+static uint64_t _wal_checksum(const wal_record_t *record, const char *key)
+{
+    // The header hash seeds the key hash, chaining both without needing a
+    // streaming XXH3 state.
+    uint64_t seed = XXH3_64bits((const char *)record + WAL_CHECKED_OFFSET,
+                                sizeof(wal_record_t) - WAL_CHECKED_OFFSET);
+    return XXH3_64bits_withSeed(key, record->key_len, seed);
+}
+
+static void _wal_keys_add(wal_keys_t *keys, const char *key, uint32_t len)
+{
+    uint64_t hash = XXH3_64bits(key, len);
+    uint64_t rest = hash << WAL_HLL_BITS;
+    uint8_t rank = rest == 0 ? 64 - WAL_HLL_BITS + 1
+                             : (uint8_t)__builtin_clzll(rest) + 1;
+    uint8_t *reg = keys->registers + (hash >> (64 - WAL_HLL_BITS));
+    if (rank > *reg)
+        *reg = rank;
+    keys->inserts++;
+}
+
+// Natural log of `x` >= 1 without pulling in libm: halve into [1, 2), then
+// ln(x) = 2 * atanh((x - 1) / (x + 1)), whose series converges quickly there.
+static double _wal_ln(double x)
+{
+    int halvings = 0;
+    for (; x >= 2.0; x /= 2.0)
+        ++halvings;
+    double z = (x - 1.0) / (x + 1.0), term = z, sum = 0.0;
+    for (int i = 1; i < 32; i += 2, term *= z * z)
+        sum += term / i;
+    return halvings * 0.69314718055994531 + 2.0 * sum;
+}
+
+// The usual HyperLogLog estimate, with linear counting for small ranges.
+static uint64_t _wal_keys_estimate(const wal_keys_t *keys)
+{
+    double m = WAL_HLL_REGISTERS, sum = 0.0;
+    int zeros = 0;
+    for (int i = 0; i < WAL_HLL_REGISTERS; ++i) {
+        sum += 1.0 / (double)((uint64_t)1 << keys->registers[i]);
+        zeros += keys->registers[i] == 0;
+    }
+    double estimate = 0.7213 / (1.0 + 1.079 / m) * m * m / sum;
+    if (estimate <= 2.5 * m && zeros > 0)
+        estimate = m * _wal_ln(m / zeros);
+    uint64_t distinct = (uint64_t)estimate;
+    return distinct < keys->inserts ? distinct : keys->inserts;
+}
+
+static bool _wal_write_all(int fd, const char *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Walks the records of a mapped log and returns the length of its valid
+// prefix. Only checksums are looked at when `map` is NULL, inserted keys also
+// being added to `keys` when it is set, otherwise every record up to `length`
+// is applied to `map` (the caller has already validated that range with a
+// previous scan).
+static size_t _wal_scan(const char *base, size_t length, hashmap_t *map,
+                        wal_keys_t *keys)
+{
+    size_t off = sizeof(wal_file_header_t), scratch_cap = 0;
+    char *scratch = NULL;
+
+    while (length - off >= sizeof(wal_record_t)) {
+        wal_record_t record;
+        memcpy(&record, base + off, sizeof(wal_record_t));
+        const char *key = base + off + sizeof(wal_record_t);
+        if (length - off - sizeof(wal_record_t) < record.key_len)
+            break;
+
+        if (map == NULL) {
+            if (record.op < WAL_OP_ADD || record.op > WAL_OP_CLEAR ||
+                _wal_checksum(&record, key) != record.checksum)
+                break;
+            if (keys != NULL && record.op == WAL_OP_CLEAR)
+                memset(keys, 0, sizeof(wal_keys_t));
+            else if (keys != NULL && record.op != WAL_OP_DELETE)
+                _wal_keys_add(keys, key, record.key_len);
+            off += sizeof(wal_record_t) + record.key_len;
+            continue;
+        }
+
+        if (record.key_len + 1 > scratch_cap) {
+            scratch_cap = 2 * (record.key_len + 1);
+            char *grown = (char *)realloc(scratch, scratch_cap);
+            if (grown == NULL)
+                break;
+            scratch = grown;
+        }
+        memcpy(scratch, key, record.key_len);
+        scratch[record.key_len] = '\0';
+
+        if (record.op == WAL_OP_DELETE) {
+            hashmap_delete(map, scratch);
+        } else if (record.op == WAL_OP_CLEAR) {
+            hashmap_clear(map);
+        } else if (!hashmap_upsert(map, scratch, record.value)) {
+            break; // the recovered map owns its keys, so scratch is copied
+        }
+        off += sizeof(wal_record_t) + record.key_len;
+    }
+
+    free(scratch);
+    return off;
+}
+
+// Fsyncs the directory holding `path`, making a rename into it durable.
+static bool _wal_sync_dir(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    size_t len = slash == NULL ? 1 : slash == path ? 1 : (size_t)(slash - path);
+    char *dir = (char *)malloc(len + 1);
+    if (dir == NULL)
+        return false;
+    memcpy(dir, slash == NULL ? "." : path, len);
+    dir[len] = '\0';
+
+    int fd = open(dir, O_RDONLY);
+    free(dir);
+    if (fd < 0)
+        return false;
+    bool success = fsync(fd) == 0;
+    close(fd);
+    return success;
+}
+
+static bool _wal_write_header(int fd)
+{
+    wal_file_header_t header = {
+            .magic = WAL_MAGIC,
+            .version = WAL_VERSION,
+    };
+    return _wal_write_all(fd, (const char *)&header, sizeof(header));
+}
+
+static bool _wal_check_header(const char *base, size_t length)
+{
+    wal_file_header_t header;
+    if (length < sizeof(header))
+        return false;
+    memcpy(&header, base, sizeof(header));
+    return header.magic == WAL_MAGIC && header.version == WAL_VERSION;
+}
+
+hashmap_wal_t *hashmap_wal_open(const char *path, int group_size)
+{
+    struct stat st;
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) != 0)
+        goto fail;
+
+    if (st.st_size == 0) {
+        if (!_wal_write_header(fd) || fsync(fd) != 0)
+            goto fail;
+    } else {
+        void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED)
+            goto fail;
+        bool valid = _wal_check_header((const char *)base, st.st_size);
+        size_t end =
+                valid ? _wal_scan((const char *)base, st.st_size, NULL, NULL)
+                      : 0;
+        munmap(base, st.st_size);
+        if (!valid)
+            goto fail;
+        // Drop a torn tail so new records are not appended after garbage.
+        if (end < (size_t)st.st_size &&
+            (ftruncate(fd, end) != 0 || fsync(fd) != 0))
+            goto fail;
+        if (lseek(fd, end, SEEK_SET) < 0)
+            goto fail;
+    }
+
+    hashmap_wal_t *wal = (hashmap_wal_t *)calloc(1, sizeof(hashmap_wal_t));
+    if (wal == NULL)
+        goto fail;
+    wal->fd = fd;
+    wal->path = (char *)malloc(strlen(path) + 1);
+    wal->group_size = group_size;
+    if (wal->path == NULL) {
+        free(wal);
+        goto fail;
+    }
+    memcpy(wal->path, path, strlen(path) + 1);
+    return wal;
+
+fail:
+    close(fd);
+    return NULL;
+}
+
+bool hashmap_wal_close(hashmap_wal_t *wal)
+{
+    if (wal == NULL)
+        return true;
+    bool success = hashmap_wal_commit(wal);
+    if (close(wal->fd) != 0)
+        success = false;
+    free(wal->buf);
+    free(wal->path);
+    free(wal);
+    return success;
+}
+
+bool hashmap_wal_reserve(hashmap_wal_t *wal, const char *key)
+{
+    size_t key_len = strlen(key), need = sizeof(wal_record_t) + key_len;
+    if (key_len > UINT32_MAX)
+        return false;
+    if (wal->len + need > wal->cap) {
+        size_t cap = wal->cap == 0 ? 4096 : wal->cap;
+        while (cap < wal->len + need)
+            cap *= 2;
+        char *grown = (char *)realloc(wal->buf, cap);
+        if (grown == NULL)
+            return false;
+        wal->buf = grown;
+        wal->cap = cap;
+    }
+    return true;
+}
+
+bool hashmap_wal_append(hashmap_wal_t *wal, wal_op_t op, const char *key,
+                        value_t value)
+{
+    size_t key_len = strlen(key), need = sizeof(wal_record_t) + key_len;
+    if (!hashmap_wal_reserve(wal, key))
+        return false;
+
+    wal_record_t record = {
+            .key_len = (uint32_t)key_len,
+            .op = op,
+            .value = value,
+    };
+    record.checksum = _wal_checksum(&record, key);
+    memcpy(wal->buf + wal->len, &record, sizeof(wal_record_t));
+    memcpy(wal->buf + wal->len + sizeof(wal_record_t), key, key_len);
+    wal->len += need;
+    wal->pending++;
+
+    // The record is buffered either way, a failed group commit leaves it
+    // pending for the next hashmap_wal_commit to retry and report.
+    if (wal->group_size > 0 && wal->pending >= wal->group_size)
+        hashmap_wal_commit(wal);
+    return true;
+}
+
+bool hashmap_wal_commit(hashmap_wal_t *wal)
+{
+    if (wal->pending == 0)
+        return true;
+    if (!_wal_write_all(wal->fd, wal->buf, wal->len) || fsync(wal->fd) != 0)
+        return false;
+    wal->committed += wal->pending;
+    wal->len = 0;
+    wal->pending = 0;
+    return true;
+}
+
+hashmap_t hashmap_wal_recover(const char *path, double load_factor_pct)
+{
+    hashmap_t map = {0}, failed = {0};
+    struct stat st;
+    void *base = NULL;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0 && errno != ENOENT)
+        return failed;
+    if (fd >= 0) {
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            return failed;
+        }
+        if (st.st_size > 0) {
+            base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (base == MAP_FAILED) {
+                close(fd);
+                return failed;
+            }
+        }
+        close(fd);
+    }
+
+    size_t length = base != NULL ? st.st_size : 0, end = 0;
+    wal_keys_t keys = {0};
+    if (base != NULL) {
+        if (!_wal_check_header((const char *)base, length)) {
+            munmap(base, length);
+            return failed;
+        }
+        end = _wal_scan((const char *)base, length, NULL, &keys);
+    }
+
+    // Presize for every distinct key inserted since the last clear, which
+    // bounds the live keys at any point of the replay, so it never rehashes.
+    uint64_t distinct = _wal_keys_estimate(&keys);
+    distinct += distinct * WAL_HLL_SLACK / 100;
+    double want = (double)(distinct + 1) / load_factor_pct + 1.0;
+    int capacity = want < 8.0 ? 8 : want > INT32_MAX / 2 ? INT32_MAX / 2
+                                                         : (int)want;
+    map = hashmap_init(capacity, load_factor_pct, _default_hasher);
+    map.owns_keys = true;
+
+    bool success = map.buckets.array != NULL;
+    if (success && base != NULL)
+        success = _wal_scan((const char *)base, end, &map, NULL) == end;
+    if (base != NULL)
+        munmap(base, length);
+    if (!success) {
+        hashmap_free(&map);
+        return failed;
+    }
+    return map;
+}
+
+bool hashmap_wal_compact(hashmap_t *map)
+{
+    hashmap_wal_t *wal = map->wal;
+    bucket_t curr, empty = {0};
+
+    if (wal == NULL)
+        return false;
+
+    size_t path_len = strlen(wal->path);
+    char *tmp = (char *)malloc(path_len + sizeof(".compact"));
+    if (tmp == NULL)
+        return false;
+    memcpy(tmp, wal->path, path_len);
+    memcpy(tmp + path_len, ".compact", sizeof(".compact"));
+
+    // Pending records are made durable first so the old log is still complete
+    // should the compaction fail part way through.
+    int fd = -1;
+    if (hashmap_wal_commit(wal))
+        fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        free(tmp);
+        return false;
+    }
+
+    // Records are staged through the log's own buffer with auto-commit off.
+    int group_size = wal->group_size;
+    wal->group_size = 0;
+
+    bool success = _wal_write_header(fd);
+    for (int i = 0; success && i < map->buckets.capacity; ++i) {
+        curr = vector_gpos_type(&map->buckets, bucket_t, i);
+        if (memcmp(&curr, &empty, sizeof(bucket_t)) == 0)
+            continue;
+        success = hashmap_wal_append(wal, WAL_OP_UPSERT, curr.key, curr.value);
+        if (success && wal->len >= (1u << 20)) {
+            success = _wal_write_all(fd, wal->buf, wal->len);
+            wal->len = 0;
+            wal->pending = 0;
+        }
+    }
+    success = success && _wal_write_all(fd, wal->buf, wal->len) &&
+              fsync(fd) == 0 && rename(tmp, wal->path) == 0;
+    wal->len = 0;
+    wal->pending = 0;
+    wal->group_size = group_size;
+
+    if (!success) {
+        close(fd);
+        unlink(tmp);
+        free(tmp);
+        return false;
+    }
+
+    // The new log is in place from here on, even if the directory entry
+    // pointing at it is not yet durable.
+    close(wal->fd);
+    wal->fd = fd;
+    free(tmp);
+    return _wal_sync_dir(wal->path) && lseek(fd, 0, SEEK_END) >= 0;
+}
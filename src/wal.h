@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef HASHMAP_WAL_H_SHARED
+#define HASHMAP_WAL_H_SHARED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "map.h"
+#include "value.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//                             Mutation Log Format                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// A log file is a wal_file_header_t followed by back-to-back records, each a
+// wal_record_t and `key_len` key bytes (not NUL-terminated). The checksum is
+// the XXH3 hash of everything in the record after the checksum field itself,
+// so a torn write at the tail of the log is detected and dropped on recovery.
+#define WAL_MAGIC 0x4c41574d48ULL // "HMWAL" little-endian
+#define WAL_VERSION 1
+
+typedef enum wal_op_t {
+    WAL_OP_ADD = 1,
+    WAL_OP_UPSERT = 2,
+    WAL_OP_DELETE = 3,
+    WAL_OP_CLEAR = 4,
+} wal_op_t;
+
+typedef struct wal_file_header_t {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t reserved;
+} wal_file_header_t;
+
+typedef struct wal_record_t {
+    uint64_t checksum;
+    uint32_t key_len;
+    uint32_t op;
+    value_t value;
+} wal_record_t;
+
+typedef struct hashmap_wal_t {
+    int fd;
+    char *path;
+    char *buf; // records appended since the last commit
+    size_t len, cap;
+    int pending;        // records in `buf`
+    int group_size;     // commit every group_size records, 0 = manual only
+    uint64_t committed; // records made durable through this handle
+} hashmap_wal_t;
+
+////////////////////////////////////////////////////////////////////////////////
+//                            Mutation Log Life Cycle                         //
+////////////////////////////////////////////////////////////////////////////////
+
+// Opens (or creates) the log at `path` for appending, truncating any torn
+// record left at its tail. Attach the result to a map with `map.wal = wal`
+// and every hashmap_add/upsert/delete/clear is logged once it has been
+// applied, so a rejected add (e.g. over max_bytes) never reaches the log.
+hashmap_wal_t *hashmap_wal_open(const char *path, int group_size);
+bool hashmap_wal_close(hashmap_wal_t *wal); // commits any pending records
+
+// Makes room in the buffer for a record of `key`, after which appending it
+// cannot fail. Maps reserve before applying a mutation and append after.
+bool hashmap_wal_reserve(hashmap_wal_t *wal, const char *key);
+bool hashmap_wal_append(hashmap_wal_t *wal, wal_op_t op, const char *key,
+                        value_t value);
+
+// Writes every pending record and fsyncs once for the whole group.
+bool hashmap_wal_commit(hashmap_wal_t *wal);
+
+////////////////////////////////////////////////////////////////////////////////
+//                         Mutation Log Recovery/Compaction                   //
+////////////////////////////////////////////////////////////////////////////////
+
+// Replays the log into a new map presized from an estimate of its distinct
+// keys, the map owns its keys. A missing log yields an empty map, a corrupt
+// header a zeroed one.
+hashmap_t hashmap_wal_recover(const char *path, double load_factor_pct);
+
+// Folds the log of `map->wal` into a fresh log holding one upsert per live
+// key, which atomically replaces the old file.
+bool hashmap_wal_compact(hashmap_t *map);
+
+#endif // !HASHMAP_WAL_H_SHARED
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assert.h"
+#include "build.h"
+#include "map.h"
+#include "pool.h"
+
+#define KEYS 100000
+
+bool check(hashmap_t *map, char **keys, int n)
+{
+    bool ok = map->buckets.size == n;
+    for (int i = 0; ok && i < n; ++i) {
+        value_t val = hashmap_get(map, keys[i]);
+        ok = _value_to_number(&val) == (double)i;
+    }
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    hashmap_pool_t *pool = hashmap_pool_open(4);
+    char **keys = (char **)calloc(KEYS + 1, sizeof(char *));
+    value_t *values = (value_t *)calloc(KEYS + 1, sizeof(value_t));
+    hashmap_t map;
+    bool ok;
+
+    for (int i = 0; i < KEYS; ++i) {
+        keys[i] = (char *)calloc(24, sizeof(char));
+        sprintf(keys[i], "key%d", i);
+        values[i] = _number_to_value((double)i);
+    }
+
+    map = hashmap_build((const char **)keys, values, KEYS, 0.75, NULL);
+    ASSERT(map.buckets.array != NULL && check(&map, keys, KEYS),
+           "serial bulk build holds every key", "check(&map, keys, KEYS)");
+    hashmap_free(&map);
+
+    map = hashmap_build((const char **)keys, values, KEYS, 0.75, pool);
+    ASSERT(map.buckets.array != NULL && check(&map, keys, KEYS),
+           "parallel bulk build holds every key", "check(&map, keys, KEYS)");
+
+    // The built table is an ordinary map: it keeps growing and deleting.
+    ok = true;
+    for (int i = 0; i < KEYS; i += 2)
+        ok = ok && hashmap_delete(&map, keys[i]);
+    ok = ok && hashmap_add(&map, "extra", TRUE_VAL) &&
+         hashmap_get(&map, "extra") == TRUE_VAL;
+    for (int i = 1; ok && i < KEYS; i += 2) {
+        value_t val = hashmap_get(&map, keys[i]);
+        ok = _value_to_number(&val) == (double)i &&
+             IS_NIL(hashmap_get(&map, keys[i - 1]));
+    }
+    ASSERT(ok == true, "built map supports the usual operations",
+           "ok == true");
+    hashmap_free(&map);
+
+    // A repeated key keeps the value given last.
+    keys[KEYS] = "key7";
+    values[KEYS] = TRUE_VAL;
+    map = hashmap_build((const char **)keys, values, KEYS + 1, 0.75, pool);
+    ASSERT(map.buckets.size == KEYS && hashmap_get(&map, "key7") == TRUE_VAL,
+           "duplicate keys keep their last value",
+           "hashmap_get(&map, \"key7\") == TRUE_VAL");
+    hashmap_free(&map);
+
+    hashmap_pool_close(pool);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,212 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assert.h"
+#include "cache.h"
+#include "map.h"
+
+#define PAYLOAD 100
+
+static int evicted;
+
+void free_payload(const char *key, value_t value)
+{
+    if (IS_OBJ(value))
+        free(AS_OBJ(value));
+    evicted++;
+}
+
+size_t payload_size(value_t value)
+{
+    return IS_OBJ(value) ? PAYLOAD : 0;
+}
+
+// Reads 50 hot keys 20 times each, then scans 10000 keys read once with a
+// hot key read after every fourth, putting every miss. Returns the hot reads
+// during the scan that hit in a 100 entry cache, out of 2500.
+int hot_hits_in_scan(cache_policy_t policy)
+{
+    hashmap_cache_t cache = hashmap_cache_init(policy, 100, 0);
+    char key[24];
+    for (int i = 0; i < 20 * 50; ++i) {
+        sprintf(key, "hot%d", i % 50);
+        if (IS_NIL(hashmap_cache_get(&cache, key)))
+            hashmap_cache_put(&cache, key, _number_to_value(i));
+    }
+    uint64_t hits = cache.hits;
+    for (int i = 0; i < 10000; ++i) {
+        sprintf(key, "scan%d", i);
+        if (IS_NIL(hashmap_cache_get(&cache, key)))
+            hashmap_cache_put(&cache, key, _number_to_value(i));
+        if (i % 4 != 3)
+            continue;
+        sprintf(key, "hot%d", i / 4 % 50);
+        if (IS_NIL(hashmap_cache_get(&cache, key)))
+            hashmap_cache_put(&cache, key, _number_to_value(i));
+    }
+    hits = cache.hits - hits;
+    hashmap_cache_free(&cache);
+    return (int)hits;
+}
+
+int main(int argc, char **argv)
+{
+    hashmap_cache_t cache;
+    char key[24];
+    bool ok;
+
+    cache = hashmap_cache_init(CACHE_LRU, 3, 0);
+    ASSERT(cache.entries != NULL, "create LRU cache", "cache.entries != NULL");
+    hashmap_cache_put(&cache, "a", _number_to_value(1));
+    hashmap_cache_put(&cache, "b", _number_to_value(2));
+    hashmap_cache_put(&cache, "c", _number_to_value(3));
+    hashmap_cache_get(&cache, "a"); // b is now least recently used
+    hashmap_cache_put(&cache, "d", _number_to_value(4));
+    ASSERT(cache.count == 3 && IS_NIL(hashmap_cache_get(&cache, "b")) &&
+                   !IS_NIL(hashmap_cache_get(&cache, "a")) &&
+                   !IS_NIL(hashmap_cache_get(&cache, "d")),
+           "LRU evicts the least recently used entry",
+           "IS_NIL(hashmap_cache_get(&cache, \"b\"))");
+
+    // a, d, c from most to least recent: replacing c refreshes it.
+    hashmap_cache_put(&cache, "c", _number_to_value(30));
+    hashmap_cache_put(&cache, "e", _number_to_value(5));
+    value_t c = hashmap_cache_get(&cache, "c");
+    ASSERT(_value_to_number(&c) == 30 && IS_NIL(hashmap_cache_get(&cache, "a")),
+           "replacing an entry refreshes it", "_value_to_number(&c) == 30");
+
+    ok = true;
+    for (int i = 0; i < 1000; ++i) {
+        sprintf(key, "churn%d", i);
+        ok = ok && hashmap_cache_put(&cache, key, _number_to_value(i));
+    }
+    ok = ok && hashmap_cache_delete(&cache, key) &&
+         !hashmap_cache_delete(&cache, key);
+    ASSERT(ok == true && cache.count == 2 && cache.len <= 4,
+           "churn reuses freed slots", "cache.len <= 4");
+    hashmap_cache_free(&cache);
+
+    cache = hashmap_cache_init(CACHE_CLOCK, 3, 0);
+    hashmap_cache_put(&cache, "a", _number_to_value(1));
+    hashmap_cache_put(&cache, "b", _number_to_value(2));
+    hashmap_cache_put(&cache, "c", _number_to_value(3));
+    hashmap_cache_get(&cache, "a");
+    hashmap_cache_get(&cache, "c");
+    hashmap_cache_put(&cache, "d", _number_to_value(4));
+    ASSERT(IS_NIL(hashmap_cache_get(&cache, "b")) &&
+                   !IS_NIL(hashmap_cache_get(&cache, "a")) &&
+                   !IS_NIL(hashmap_cache_get(&cache, "c")),
+           "CLOCK gives referenced entries a second chance",
+           "IS_NIL(hashmap_cache_get(&cache, \"b\"))");
+    ASSERT(cache.hits == 4 && cache.misses == 1 && cache.evictions == 1,
+           "hits, misses and evictions are counted",
+           "cache.hits == 4 && cache.evictions == 1");
+    hashmap_cache_free(&cache);
+
+    // A byte budget of ten payloads, whatever the entry count.
+    size_t entry = sizeof(cache_entry_t) + strlen("obj00") + 1 + PAYLOAD;
+    cache = hashmap_cache_init(CACHE_LRU, 0, 10 * entry);
+    cache.on_evict = free_payload;
+    cache.size_fn = payload_size;
+    ok = true;
+    for (int i = 10; i < 100; ++i) {
+        sprintf(key, "obj%d", i);
+        ok = ok && hashmap_cache_put(&cache, key, OBJ_VAL(malloc(PAYLOAD))) &&
+             cache.bytes <= cache.max_bytes;
+    }
+    ASSERT(ok == true && cache.count == 10, "byte budget bounds the cache",
+           "cache.bytes <= cache.max_bytes");
+
+    char *huge = (char *)calloc(11 * entry, sizeof(char));
+    memset(huge, 'k', 11 * entry - 1);
+    ok = hashmap_cache_put(&cache, huge, TRUE_VAL);
+    ASSERT(ok == false && cache.count == 10,
+           "an entry over the budget alone is refused", "ok == false");
+    free(huge);
+    hashmap_cache_free(&cache);
+    ASSERT(evicted == 90, "every payload reaches the eviction callback",
+           "evicted == 90");
+
+    // Expiry spread over the lower three wheel levels.
+    evicted = 0;
+    cache = hashmap_cache_init(CACHE_LRU, 0, 0);
+    cache.on_evict = free_payload;
+    hashmap_cache_expire(&cache, 1000, 0);
+    for (int i = 0; i < 100; ++i) {
+        sprintf(key, "session%d", i);
+        hashmap_cache_put_ttl(&cache, key, _number_to_value(i), 1000 + i * 100);
+    }
+    ok = hashmap_cache_expire(&cache, 1000 + 50 * 100, 1000) == 51 &&
+         IS_NIL(hashmap_cache_get(&cache, "session50")) &&
+         !IS_NIL(hashmap_cache_get(&cache, "session51"));
+    ASSERT(ok == true && cache.count == 49,
+           "expire removes exactly the entries due", "cache.count == 49");
+
+    ok = hashmap_cache_expire(&cache, 1000 + 60 * 100, 0) == 0 &&
+         IS_NIL(hashmap_cache_get(&cache, "session55")) && cache.count == 48 &&
+         hashmap_cache_expire(&cache, 1000 + 60 * 100, 3) == 3 &&
+         hashmap_cache_expire(&cache, 1000 + 60 * 100, 100) == 6;
+    ASSERT(ok == true, "gets drop expired entries and budgets bound expire",
+           "ok == true");
+
+    // The replaced session99 reaches on_evict too.
+    hashmap_cache_put(&cache, "session99", TRUE_VAL);
+    hashmap_cache_put_ttl(&cache, "far", TRUE_VAL, 1000 + (1ULL << 30));
+    ok = hashmap_cache_expire(&cache, 1000 + (1ULL << 30) - 1, 1000) == 38 &&
+         hashmap_cache_get(&cache, "session99") == TRUE_VAL &&
+         hashmap_cache_get(&cache, "far") == TRUE_VAL &&
+         hashmap_cache_expire(&cache, 1000 + (1ULL << 30), 1000) == 1;
+    ASSERT(ok == true && cache.count == 1 && cache.expirations == 100 &&
+                   evicted == 101,
+           "far expiries cascade down and plain puts clear expiry",
+           "cache.expirations == 100");
+    hashmap_cache_free(&cache);
+
+    // A scan flushes LRU but not the frequency aware policies.
+    int lru = hot_hits_in_scan(CACHE_LRU);
+    int tinylfu = hot_hits_in_scan(CACHE_TINYLFU);
+    int s3fifo = hot_hits_in_scan(CACHE_S3FIFO);
+    ASSERT(lru < 100 && tinylfu > 2400 && s3fifo > 2400,
+           "TinyLFU and S3-FIFO keep hot keys through a scan",
+           "tinylfu > 2400 && s3fifo > 2400");
+
+    ok = true;
+    for (cache_policy_t policy = CACHE_TINYLFU; policy <= CACHE_S3FIFO;
+         ++policy) {
+        cache = hashmap_cache_init(policy, 64, 0);
+        for (int i = 0; ok && i < 5000; ++i) {
+            sprintf(key, "mix%d", i % 7 == 0 ? i % 20 : i);
+            if (IS_NIL(hashmap_cache_get(&cache, key)))
+                ok = hashmap_cache_put(&cache, key, _number_to_value(i));
+            ok = ok && cache.count <= 64;
+        }
+        int queued = 0;
+        for (int q = 0; q < CACHE_QUEUES; ++q)
+            queued += cache.queues[q].count;
+        ok = ok && queued == cache.count;
+        hashmap_cache_free(&cache);
+    }
+    ASSERT(ok == true, "admission policies stay within their entry limit",
+           "ok == true");
+
+    // An index that cannot grow rejects the put after the entry array
+    // has, the fresh slot it handed out must not be freed as a key.
+    cache = hashmap_cache_init(CACHE_LRU, 0, 0);
+    cache.index.max_bytes = cache.index.buckets.capacity * sizeof(bucket_t);
+    int stored = 0;
+    for (ok = true; ok; ++stored) {
+        sprintf(key, "full%d", stored);
+        ok = hashmap_cache_put(&cache, key, _number_to_value(stored));
+    }
+    ok = cache.count == stored - 1 && cache.len > cache.count;
+    hashmap_cache_free(&cache);
+    ASSERT(ok == true, "a rejected put leaves its slot empty", "ok == true");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assert.h"
+#include "combining.h"
+#include "map.h"
+
+#define THREADS 4
+#define HOT_KEYS 16
+#define PER_THREAD 20000
+
+typedef struct worker_t {
+    hashmap_combining_t *map;
+    char **keys;
+    bool ok;
+} worker_t;
+
+// Every thread hammers the same few counters.
+void *counter(void *arg)
+{
+    worker_t *w = (worker_t *)arg;
+    combining_thread_t *self = hashmap_combining_register(w->map);
+    w->ok = self != NULL;
+    for (int i = 0; w->ok && i < PER_THREAD; ++i)
+        hashmap_combining_increment(w->map, self, w->keys[i % HOT_KEYS], 1);
+    hashmap_combining_unregister(w->map, self);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    pthread_t threads[THREADS];
+    worker_t workers[THREADS];
+    hashmap_combining_t map;
+    char *keys[HOT_KEYS];
+    bool ok;
+
+    for (int i = 0; i < HOT_KEYS; ++i) {
+        keys[i] = (char *)calloc(24, sizeof(char));
+        sprintf(keys[i], "counter%d", i);
+    }
+
+    map = hashmap_combining_init(64, 0.75, _default_hasher);
+    ASSERT(map.threads != NULL, "create combining map", "map.threads != NULL");
+
+    for (int i = 0; i < THREADS; ++i) {
+        workers[i].map = &map;
+        workers[i].keys = keys;
+        pthread_create(&threads[i], NULL, counter, &workers[i]);
+    }
+    ok = true;
+    for (int i = 0; i < THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+        ok = ok && workers[i].ok;
+    }
+
+    combining_thread_t *self = hashmap_combining_register(&map);
+    for (int i = 0; ok && i < HOT_KEYS; ++i) {
+        value_t val = hashmap_combining_get(&map, self, keys[i]);
+        ok = _value_to_number(&val) == THREADS * PER_THREAD / HOT_KEYS;
+    }
+    ASSERT(ok == true, "concurrent increments are all counted", "ok == true");
+    ASSERT(map.updates == THREADS * PER_THREAD &&
+                   map.writes <= map.updates / (COMBINING_BUFFER / HOT_KEYS),
+           "duplicate keys merge into one write per pass",
+           "map.writes <= map.updates / (COMBINING_BUFFER / HOT_KEYS)");
+
+    // Buffered updates to one key fold in program order.
+    hashmap_combining_increment(&map, self, "mixed", 5);
+    hashmap_combining_upsert(&map, self, "mixed", _number_to_value(10));
+    hashmap_combining_increment(&map, self, "mixed", 1);
+    hashmap_combining_delete(&map, self, "gone");
+    hashmap_combining_upsert(&map, self, "flag", TRUE_VAL);
+    hashmap_combining_increment(&map, self, "flag", 2);
+    value_t mixed = hashmap_combining_get(&map, self, "mixed");
+    ASSERT(_value_to_number(&mixed) == 11 &&
+                   IS_NIL(hashmap_combining_get(&map, self, "gone")),
+           "updates to one key keep their order",
+           "_value_to_number(&mixed) == 11");
+    value_t flag = hashmap_combining_get(&map, self, "flag");
+    ASSERT(_value_to_number(&flag) == 2,
+           "incrementing a non-number replaces it",
+           "_value_to_number(&flag) == 2");
+
+    hashmap_combining_delete(&map, self, keys[0]);
+    hashmap_combining_increment(&map, self, keys[0], 3);
+    value_t restarted = hashmap_combining_get(&map, self, keys[0]);
+    ASSERT(_value_to_number(&restarted) == 3,
+           "increment after delete starts from zero",
+           "_value_to_number(&restarted) == 3");
+
+    hashmap_combining_unregister(&map, self);
+    hashmap_combining_free(&map);
+    return EXIT_SUCCESS;
+}
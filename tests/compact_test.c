@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assert.h"
+#include "compact.h"
+#include "map.h"
+
+int main(int argc, char **argv)
+{
+    hashmap_compact_t map;
+    const char *key;
+    value_t val;
+    bool ok;
+    int iter, i;
+
+    map = hashmap_compact_init(4);
+    ASSERT(map.index != NULL && map.index_width == 1,
+           "validate new compact map starts with a 1 byte index",
+           "map.index != NULL && map.index_width == 1");
+
+    static char *buf;
+    for (i = 0; i < 100000; ++i) {
+        buf = (char *)calloc(16, sizeof(char));
+        sprintf(buf, "key%d", i);
+        if (!hashmap_compact_add(&map, buf, _number_to_value((double)i)))
+            break;
+    }
+    ASSERT(i == 100000 && map.used == 100000,
+           "add values to compact mapping across resizes",
+           "i == 100000 && map.used == 100000");
+    ASSERT(map.index_width == 4,
+           "index width grows with the index size",
+           "map.index_width == 4");
+
+    ok = true;
+    for (i = 0; i < 100000; ++i) {
+        char tmp[16] = {0};
+        sprintf(tmp, "key%d", i);
+        val = hashmap_compact_get(&map, tmp);
+        ok = ok && _value_to_number(&val) == (double)i;
+    }
+    ASSERT(ok == true, "validate values in compact mapping", "ok == true");
+
+    val = hashmap_compact_get(&map, "missing");
+    ASSERT(IS_NIL(val), "missing key returns NIL_VAL", "IS_NIL(val)");
+
+    ok = true;
+    for (i = 0; i < 100000; i += 2) {
+        char tmp[16] = {0};
+        sprintf(tmp, "key%d", i);
+        ok = ok && hashmap_compact_delete(&map, tmp);
+    }
+    ASSERT(ok == true && map.used == 50000,
+           "delete every other key from compact mapping",
+           "ok == true && map.used == 50000");
+    ASSERT(hashmap_compact_delete(&map, "key0") == false,
+           "deleting a missing key fails",
+           "hashmap_compact_delete(&map, \"key0\") == false");
+
+    iter = 0;
+    ok = true;
+    for (i = 1; hashmap_compact_next(&map, &iter, &key, &val); i += 2) {
+        char tmp[16] = {0};
+        sprintf(tmp, "key%d", i);
+        ok = ok && strcmp(key, tmp) == 0 && _value_to_number(&val) == (double)i;
+    }
+    ASSERT(ok == true && i == 100001,
+           "iteration yields live entries in insertion order",
+           "ok == true && i == 100001");
+
+    hashmap_compact_free(&map);
+
+    map = hashmap_compact_init(8);
+    hashmap_compact_add(&map, "one", _number_to_value(1.0));
+    hashmap_compact_add(&map, "two", _number_to_value(2.0));
+    hashmap_compact_add(&map, "three", _number_to_value(3.0));
+    hashmap_compact_add(&map, "one", _number_to_value(11.0));
+    hashmap_compact_delete(&map, "two");
+    hashmap_compact_add(&map, "two", _number_to_value(22.0));
+
+    const char *order[3] = {"one", "three", "two"};
+    double nums[3] = {11.0, 3.0, 22.0};
+    iter = 0;
+    ok = true;
+    for (i = 0; hashmap_compact_next(&map, &iter, &key, &val); ++i)
+        ok = ok && i < 3 && strcmp(key, order[i]) == 0 &&
+             _value_to_number(&val) == nums[i];
+    ASSERT(ok == true && i == 3,
+           "updates keep position and re-added keys move to the end",
+           "ok == true && i == 3");
+
+    hashmap_compact_clear(&map);
+    iter = 0;
+    ASSERT(map.used == 0 && !hashmap_compact_next(&map, &iter, &key, &val),
+           "cleared compact map is empty",
+           "map.used == 0 && !hashmap_compact_next(&map, &iter, &key, &val)");
+
+    hashmap_compact_free(&map);
+
+    // The dense array and index together should cost less per entry than
+    // hashmap_t's table holding the same keys.
+    static const int sizes[] = {1000, 50000, 300000};
+    char **keys = (char **)calloc(300000, sizeof(char *));
+    for (i = 0; i < 300000; ++i) {
+        keys[i] = (char *)calloc(16, sizeof(char));
+        sprintf(keys[i], "key%d", i);
+    }
+    ok = true;
+    for (int s = 0; s < 3; ++s) {
+        hashmap_t table = hashmap_init(16, 0.75, _default_hasher);
+        map = hashmap_compact_init(4);
+        for (i = 0; i < sizes[s]; ++i) {
+            hashmap_compact_add(&map, keys[i], TRUE_VAL);
+            hashmap_add(&table, keys[i], TRUE_VAL);
+        }
+        size_t bytes = (size_t)map.entries.capacity * sizeof(entry_t) +
+                       (size_t)map.index_size * map.index_width;
+        ok = ok && map.used == sizes[s] &&
+             bytes < hashmap_memory_usage(&table).table;
+        hashmap_compact_free(&map);
+        hashmap_free(&table);
+    }
+    ASSERT(ok == true, "compact map uses fewer bytes per entry than hashmap_t",
+           "ok == true");
+    for (i = 0; i < 300000; ++i)
+        free(keys[i]);
+    free(keys);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,246 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assert.h"
+#include "concurrent.h"
+
+#define THREADS 8
+#define PER_THREAD 5000
+#define CHURN 20000
+#define COUNTERS 1000
+
+static _Atomic int objs_freed;
+
+typedef struct worker_t {
+    hashmap_concurrent_t *map;
+    char **keys;
+    int id;
+    bool ok;
+} worker_t;
+
+void *writer(void *arg)
+{
+    worker_t *w = (worker_t *)arg;
+    w->ok = true;
+    for (int i = 0; i < PER_THREAD; ++i) {
+        int n = w->id * PER_THREAD + i;
+        w->ok = hashmap_concurrent_add(w->map, w->keys[n],
+                                       _number_to_value((double)n)) &&
+                w->ok;
+    }
+    return NULL;
+}
+
+// Runs alongside the writers, every value seen must be either missing (not
+// yet inserted) or exactly the value written for that key.
+void *reader(void *arg)
+{
+    worker_t *w = (worker_t *)arg;
+    w->ok = true;
+    for (int i = 0; i < THREADS * PER_THREAD; ++i) {
+        value_t val = hashmap_concurrent_get(w->map, w->keys[i]);
+        w->ok = w->ok && (IS_NIL(val) || _value_to_number(&val) == (double)i);
+    }
+    return NULL;
+}
+
+void *deleter(void *arg)
+{
+    worker_t *w = (worker_t *)arg;
+    w->ok = true;
+    for (int i = 0; i < PER_THREAD; i += 2) {
+        int n = w->id * PER_THREAD + i;
+        w->ok = hashmap_concurrent_delete(w->map, w->keys[n]) && w->ok;
+    }
+    return NULL;
+}
+
+void free_obj(void *obj)
+{
+    free(obj);
+    atomic_fetch_add(&objs_freed, 1);
+}
+
+// Adds and deletes a stream of distinct keys built on the stack, so only the
+// map's own copies of them survive.
+void *churner(void *arg)
+{
+    worker_t *w = (worker_t *)arg;
+    w->ok = true;
+    for (int i = 0; i < CHURN; ++i) {
+        char key[32] = {0};
+        sprintf(key, "churn%d-%d", w->id, i);
+        w->ok = hashmap_concurrent_add(w->map, key, TRUE_VAL) &&
+                hashmap_concurrent_get(w->map, key) == TRUE_VAL &&
+                hashmap_concurrent_delete(w->map, key) && w->ok;
+    }
+    return NULL;
+}
+
+// Bumps shared counters, half through fetch-and-add and half through a
+// compare-and-swap loop, while the table keeps growing under them.
+void *counter(void *arg)
+{
+    worker_t *w = (worker_t *)arg;
+    w->ok = true;
+    for (int i = 0; i < PER_THREAD; ++i) {
+        const char *key = w->keys[i % COUNTERS];
+        if (i % 2 == 0) {
+            w->ok = hashmap_concurrent_fetch_add_number(w->map, key, 1, NULL) &&
+                    w->ok;
+            continue;
+        }
+        for (;;) {
+            value_t curr = hashmap_concurrent_get(w->map, key);
+            double n = IS_NIL(curr) ? 0 : _value_to_number(&curr);
+            if (hashmap_concurrent_cas(w->map, key, curr,
+                                       _number_to_value(n + 1)))
+                break;
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    pthread_t threads[2 * THREADS];
+    worker_t workers[2 * THREADS];
+    hashmap_concurrent_t map;
+    bool ok;
+
+    char **keys = (char **)calloc(THREADS * PER_THREAD, sizeof(char *));
+    for (int i = 0; i < THREADS * PER_THREAD; ++i) {
+        keys[i] = (char *)calloc(24, sizeof(char));
+        sprintf(keys[i], "key%d", i);
+    }
+
+    // Start tiny so the writers keep outgrowing the table, and helping to
+    // move it, while the readers run.
+    map = hashmap_concurrent_init(16, 0.75);
+    ASSERT(atomic_load(&map.table) != NULL, "create concurrent map",
+           "atomic_load(&map.table) != NULL");
+
+    for (int i = 0; i < 2 * THREADS; ++i) {
+        workers[i].map = &map;
+        workers[i].keys = keys;
+        workers[i].id = i % THREADS;
+        pthread_create(&threads[i], NULL, i < THREADS ? writer : reader,
+                       &workers[i]);
+    }
+    ok = true;
+    for (int i = 0; i < 2 * THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+        ok = ok && workers[i].ok;
+    }
+    ASSERT(ok == true, "concurrent adds alongside readers", "ok == true");
+
+    ok = true;
+    for (int i = 0; i < THREADS * PER_THREAD; ++i) {
+        char tmp[24] = {0};
+        sprintf(tmp, "key%d", i);
+        value_t val = hashmap_concurrent_get(&map, tmp);
+        ok = ok && _value_to_number(&val) == (double)i;
+    }
+    ASSERT(ok == true, "every concurrently added value is present",
+           "ok == true");
+    ASSERT(atomic_load(&map.table)->capacity >= THREADS * PER_THREAD,
+           "concurrent adds grow the table",
+           "atomic_load(&map.table)->capacity >= THREADS * PER_THREAD");
+
+    for (int i = 0; i < THREADS; ++i)
+        pthread_create(&threads[i], NULL, deleter, &workers[i]);
+    ok = true;
+    for (int i = 0; i < THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+        ok = ok && workers[i].ok;
+    }
+    for (int i = 0; i < THREADS * PER_THREAD; ++i) {
+        value_t val = hashmap_concurrent_get(&map, keys[i]);
+        ok = ok && ((i % PER_THREAD) % 2 == 0
+                            ? IS_NIL(val)
+                            : _value_to_number(&val) == (double)i);
+    }
+    ASSERT(ok == true, "concurrent deletes only remove their own keys",
+           "ok == true");
+    hashmap_concurrent_free(&map);
+
+    map = hashmap_concurrent_init(16, 0.5);
+    ok = true;
+    for (int i = 0; i < 8; ++i)
+        ok = ok && hashmap_concurrent_add(&map, keys[i], TRUE_VAL);
+    ok = ok && hashmap_concurrent_delete(&map, keys[1]);
+    ASSERT(ok == true && hashmap_concurrent_add(&map, keys[8], TRUE_VAL) &&
+                   atomic_load(&map.table)->capacity == 32,
+           "adding past the load factor grows the table",
+           "atomic_load(&map.table)->capacity == 32");
+    ASSERT(IS_NIL(hashmap_concurrent_get(&map, keys[1])) &&
+                   hashmap_concurrent_get(&map, keys[0]) == TRUE_VAL &&
+                   hashmap_concurrent_get(&map, keys[8]) == TRUE_VAL,
+           "growth moves live keys and drops deleted ones",
+           "IS_NIL(hashmap_concurrent_get(&map, keys[1]))");
+    hashmap_concurrent_free(&map);
+
+    map = hashmap_concurrent_init(16, 0.75);
+    map.owns_keys = true;
+    for (int i = 0; i < THREADS; ++i)
+        pthread_create(&threads[i], NULL, churner, &workers[i]);
+    ok = true;
+    for (int i = 0; i < THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+        ok = ok && workers[i].ok;
+    }
+    ASSERT(ok == true && atomic_load(&map.table)->capacity <= 64,
+           "churn with owned keys does not grow the table",
+           "atomic_load(&map.table)->capacity <= 64");
+    hashmap_concurrent_free(&map);
+
+    map = hashmap_concurrent_init(16, 0.75);
+    for (int i = 0; i < THREADS; ++i)
+        pthread_create(&threads[i], NULL, counter, &workers[i]);
+    ok = true;
+    for (int i = 0; i < THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+        ok = ok && workers[i].ok;
+    }
+    for (int i = 0; i < COUNTERS; ++i) {
+        value_t val = hashmap_concurrent_get(&map, keys[i]);
+        ok = ok && _value_to_number(&val) == THREADS * PER_THREAD / COUNTERS;
+    }
+    ASSERT(ok == true, "concurrent fetch-add and cas lose no increments",
+           "ok == true");
+
+    double prev = -1;
+    hashmap_concurrent_upsert(&map, keys[0], TRUE_VAL);
+    ok = !hashmap_concurrent_fetch_add_number(&map, keys[0], 1, &prev) &&
+         prev == -1 &&
+         !hashmap_concurrent_cas(&map, keys[0], FALSE_VAL, NIL_VAL) &&
+         hashmap_concurrent_exchange(&map, keys[0], FALSE_VAL) == TRUE_VAL &&
+         hashmap_concurrent_cas(&map, keys[0], FALSE_VAL, NIL_VAL) &&
+         !hashmap_concurrent_cas(&map, keys[1], NIL_VAL, TRUE_VAL) &&
+         IS_NIL(hashmap_concurrent_get(&map, keys[0])) &&
+         hashmap_concurrent_cas(&map, keys[0], NIL_VAL, TRUE_VAL) &&
+         IS_NIL(hashmap_concurrent_exchange(&map, "missing", NIL_VAL));
+    ASSERT(ok == true, "atomic updates respect the current value",
+           "ok == true");
+    hashmap_concurrent_free(&map);
+
+    map = hashmap_concurrent_init(16, 0.75);
+    map.free_obj = free_obj;
+    for (int i = 0; i < 100; ++i)
+        hashmap_concurrent_upsert(&map, keys[i % 10],
+                                  OBJ_VAL(calloc(1, sizeof(int))));
+    hashmap_concurrent_delete(&map, keys[0]);
+    hashmap_concurrent_free(&map);
+    ASSERT(atomic_load(&objs_freed) == 100,
+           "replaced, deleted and remaining objects are all freed",
+           "atomic_load(&objs_freed) == 100");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,155 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#define _POSIX_C_SOURCE 200809L // nanosleep
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "assert.h"
+#include "delegate.h"
+
+#define CLIENTS 4
+#define PER_CLIENT 2000
+
+typedef struct worker_t {
+    hashmap_delegate_t *map;
+    char **keys;
+    int id;
+    bool ok;
+} worker_t;
+
+// Blocking calls on the client's own keys, then every key of every client
+// is read back asynchronously once all writers are done.
+void *client(void *arg)
+{
+    worker_t *w = (worker_t *)arg;
+    delegate_client_t *self = hashmap_delegate_register(w->map);
+    w->ok = self != NULL;
+    for (int i = 0; w->ok && i < PER_CLIENT; ++i) {
+        int n = w->id * PER_CLIENT + i;
+        w->ok = hashmap_delegate_add(w->map, self, w->keys[n],
+                                     _number_to_value((double)n));
+        value_t val = hashmap_delegate_get(w->map, self, w->keys[n]);
+        w->ok = w->ok && _value_to_number(&val) == (double)n;
+    }
+    hashmap_delegate_unregister(w->map, self);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    pthread_t threads[CLIENTS];
+    worker_t workers[CLIENTS];
+    hashmap_delegate_t map;
+    bool ok;
+
+    char **keys = (char **)calloc(CLIENTS * PER_CLIENT, sizeof(char *));
+    for (int i = 0; i < CLIENTS * PER_CLIENT; ++i) {
+        keys[i] = (char *)calloc(24, sizeof(char));
+        sprintf(keys[i], "key%d", i);
+    }
+
+    map = hashmap_delegate_init(3, 64, 0.75);
+    ASSERT(map.owners != NULL && map.nowners == 3, "create delegated map",
+           "map.owners != NULL && map.nowners == 3");
+
+    for (int i = 0; i < CLIENTS; ++i) {
+        workers[i].map = &map;
+        workers[i].keys = keys;
+        workers[i].id = i;
+        pthread_create(&threads[i], NULL, client, &workers[i]);
+    }
+    ok = true;
+    for (int i = 0; i < CLIENTS; ++i) {
+        pthread_join(threads[i], NULL);
+        ok = ok && workers[i].ok;
+    }
+    ASSERT(ok == true, "blocking calls from concurrent clients", "ok == true");
+
+    // Keep as many gets in flight as the rings allow, matching each result
+    // back to its key through the ticket.
+    delegate_client_t *self = hashmap_delegate_register(&map);
+    uint64_t first = 0;
+    int submitted = 0, completed = 0;
+    ok = true;
+    while (completed < CLIENTS * PER_CLIENT) {
+        uint64_t ticket;
+        delegate_msg_t result;
+        if (submitted < CLIENTS * PER_CLIENT &&
+            hashmap_delegate_submit(&map, self, DELEGATE_GET, keys[submitted],
+                                    NIL_VAL, &ticket)) {
+            if (submitted++ == 0)
+                first = ticket;
+            continue;
+        }
+        while (hashmap_delegate_poll(&map, self, &result)) {
+            int n = (int)(result.ticket - first);
+            ok = ok && result.ok && _value_to_number(&result.value) == n;
+            completed++;
+        }
+    }
+    ASSERT(ok == true, "asynchronous gets return every value", "ok == true");
+
+    uint64_t ticket;
+    delegate_msg_t result;
+    hashmap_delegate_submit(&map, self, DELEGATE_DELETE, keys[0], NIL_VAL,
+                            &ticket);
+    ok = IS_NIL(hashmap_delegate_get(&map, self, keys[0])) &&
+         hashmap_delegate_poll(&map, self, &result) &&
+         result.ticket == ticket && result.ok;
+    ASSERT(ok == true, "blocking calls keep earlier asynchronous results",
+           "ok == true");
+    ASSERT(hashmap_delegate_upsert(&map, self, keys[0], TRUE_VAL) &&
+                   hashmap_delegate_get(&map, self, keys[0]) == TRUE_VAL &&
+                   !hashmap_delegate_delete(&map, self, "missing"),
+           "blocking upsert and delete",
+           "hashmap_delegate_get(&map, self, keys[0]) == TRUE_VAL");
+
+    // Idle owners park rather than spin, and a request wakes them again.
+    ok = false;
+    for (int wait = 0; !ok && wait < 200; ++wait) {
+        struct timespec ms = {.tv_nsec = 10000000};
+        nanosleep(&ms, NULL);
+        ok = true;
+        for (int i = 0; i < map.nowners; ++i)
+            ok = ok && atomic_load(&map.owners[i].parked);
+    }
+    ASSERT(ok == true && hashmap_delegate_get(&map, self, keys[1]) != NIL_VAL,
+           "idle owners park and wake on a request",
+           "ok == true && hashmap_delegate_get(&map, self, keys[1]) != "
+           "NIL_VAL");
+
+    // Unpolled results pile up in the stash while blocking calls run, so
+    // submit refuses more than it can hold.
+    int *key_of = (int *)calloc(4 * CLIENTS * PER_CLIENT, sizeof(int));
+    int accepted = 0;
+    first = 0;
+    for (int i = 1; i < CLIENTS * PER_CLIENT; ++i) {
+        if (!hashmap_delegate_submit(&map, self, DELEGATE_GET, keys[i],
+                                     NIL_VAL, &ticket))
+            break;
+        if (first == 0)
+            first = ticket;
+        key_of[ticket - first] = i;
+        accepted++;
+        hashmap_delegate_get(&map, self, keys[i]);
+    }
+    ok = accepted == self->stash_cap;
+    for (int i = 0; i < accepted; ++i)
+        ok = ok && hashmap_delegate_poll(&map, self, &result) &&
+             _value_to_number(&result.value) == key_of[result.ticket - first];
+    ok = ok && !hashmap_delegate_poll(&map, self, &result);
+    ASSERT(ok == true, "unpolled results are bounded by the stash",
+           "ok == true");
+    free(key_of);
+
+    hashmap_delegate_unregister(&map, self);
+    hashmap_delegate_free(&map);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assert.h"
+#include "ebr.h"
+
+#define READERS 4
+#define SWAPS 20000
+#define NODE_LIVE 0x11feULL
+#define NODE_DEAD 0xdeadULL
+
+typedef struct node_t {
+    uint64_t magic;
+} node_t;
+
+static hashmap_ebr_t ebr;
+static _Atomic(node_t *) current;
+static _Atomic bool done;
+static _Atomic int freed;
+
+void free_node(void *ptr)
+{
+    ((node_t *)ptr)->magic = NODE_DEAD;
+    free(ptr);
+    atomic_fetch_add(&freed, 1);
+}
+
+node_t *new_node(void)
+{
+    node_t *node = (node_t *)malloc(sizeof(node_t));
+    node->magic = NODE_LIVE;
+    return node;
+}
+
+// Every node loaded inside a critical section must still be live when read.
+void *reader(void *arg)
+{
+    bool *ok = (bool *)arg;
+    ebr_thread_t *self = hashmap_ebr_self(&ebr);
+    *ok = self != NULL;
+    while (*ok && !atomic_load(&done)) {
+        hashmap_ebr_enter(&ebr, self);
+        node_t *node = atomic_load(&current);
+        *ok = node->magic == NODE_LIVE;
+        hashmap_ebr_exit(&ebr, self);
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    pthread_t threads[READERS];
+    bool oks[READERS];
+    bool ok;
+
+    ebr = hashmap_ebr_init();
+    ASSERT(ebr.threads != NULL, "create ebr domain", "ebr.threads != NULL");
+
+    atomic_init(&current, new_node());
+    for (int i = 0; i < READERS; ++i)
+        pthread_create(&threads[i], NULL, reader, &oks[i]);
+
+    // A reader descheduled inside its critical section stalls reclamation,
+    // so keep swapping (up to a limit) until something has been freed.
+    ebr_thread_t *self = hashmap_ebr_self(&ebr);
+    int swaps = 0;
+    while (swaps < SWAPS ||
+           (atomic_load(&freed) == 0 && swaps < 100 * SWAPS)) {
+        node_t *old = atomic_exchange(&current, new_node());
+        hashmap_ebr_retire(&ebr, self, old, free_node);
+        swaps++;
+    }
+    atomic_store(&done, true);
+    ok = true;
+    for (int i = 0; i < READERS; ++i) {
+        pthread_join(threads[i], NULL);
+        ok = ok && oks[i];
+    }
+    ASSERT(ok == true, "readers never see a reclaimed node", "ok == true");
+    ASSERT(atomic_load(&freed) > 0, "retired nodes are freed while running",
+           "atomic_load(&freed) > 0");
+
+    for (int i = 0; i < 3; ++i)
+        hashmap_ebr_collect(&ebr, self);
+    ASSERT(atomic_load(&freed) == swaps,
+           "every retired node is freed once all threads are quiescent",
+           "atomic_load(&freed) == swaps");
+
+    // A pinned thread holds reclamation back, however often others collect.
+    ebr_thread_t *pinned = hashmap_ebr_register(&ebr);
+    hashmap_ebr_enter(&ebr, pinned);
+    hashmap_ebr_enter(&ebr, pinned);
+    hashmap_ebr_exit(&ebr, pinned);
+    hashmap_ebr_retire(&ebr, self, atomic_exchange(&current, new_node()),
+                       free_node);
+    for (int i = 0; i < 5; ++i)
+        hashmap_ebr_collect(&ebr, self);
+    ASSERT(atomic_load(&freed) == swaps,
+           "nested pin keeps retired memory alive",
+           "atomic_load(&freed) == swaps");
+    hashmap_ebr_exit(&ebr, pinned);
+    for (int i = 0; i < 3; ++i)
+        hashmap_ebr_collect(&ebr, self);
+    ASSERT(atomic_load(&freed) == swaps + 1,
+           "retired memory is freed after the last pin is dropped",
+           "atomic_load(&freed) == swaps + 1");
+    hashmap_ebr_unregister(&ebr, pinned);
+
+    hashmap_ebr_retire(&ebr, self, atomic_exchange(&current, NULL), free_node);
+    hashmap_ebr_free(&ebr);
+    ASSERT(atomic_load(&freed) == swaps + 2,
+           "freeing the domain frees everything still retired",
+           "atomic_load(&freed) == swaps + 2");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assert.h"
+#include "frozen.h"
+#include "map.h"
+
+int main(int argc, char **argv)
+{
+    hashmap_t map;
+    hashmap_frozen_t frozen;
+    value_t val;
+    bool ok;
+
+    map = hashmap_init(16, 0.6, _default_hasher);
+
+    frozen = hashmap_freeze(&map);
+    val = hashmap_frozen_get(&frozen, "key0");
+    ASSERT(frozen.size == 0 && IS_NIL(val),
+           "freezing an empty map yields an empty frozen map",
+           "frozen.size == 0 && IS_NIL(val)");
+    hashmap_frozen_free(&frozen);
+
+    static char *buf;
+    for (int i = 0; i < 5000; ++i) {
+        buf = (char *)calloc(16, sizeof(char));
+        sprintf(buf, "key%d", i);
+        hashmap_add(&map, buf, _number_to_value((double)i));
+    }
+
+    frozen = hashmap_freeze(&map);
+    ASSERT(frozen.slots != NULL && frozen.size == 5000 &&
+                   frozen.capacity <= 5051,
+           "frozen map holds about one slot per key",
+           "frozen.slots != NULL && frozen.size == 5000 && "
+           "frozen.capacity <= 5051");
+
+    ok = true;
+    for (int i = 0; i < 5000; ++i) {
+        char tmp[16] = {0};
+        sprintf(tmp, "key%d", i);
+        val = hashmap_frozen_get(&frozen, tmp);
+        ok = ok && _value_to_number(&val) == (double)i;
+    }
+    ASSERT(ok == true, "validate every value in frozen mapping", "ok == true");
+
+    ok = true;
+    for (int i = 5000; i < 10000; ++i) {
+        char tmp[16] = {0};
+        sprintf(tmp, "key%d", i);
+        ok = ok && IS_NIL(hashmap_frozen_get(&frozen, tmp));
+    }
+    ASSERT(ok == true, "missing keys return NIL_VAL from frozen mapping",
+           "ok == true");
+
+    hashmap_frozen_free(&frozen);
+    hashmap_free(&map);
+
+    // Large key sets still find a pilot for their last buckets.
+    map = hashmap_init(16, 0.75, _default_hasher);
+    map.owns_keys = true;
+    for (int i = 0; i < 1000000; ++i) {
+        char tmp[16] = {0};
+        sprintf(tmp, "key%d", i);
+        hashmap_add(&map, tmp, _number_to_value((double)i));
+    }
+    frozen = hashmap_freeze(&map);
+    val = hashmap_frozen_get(&frozen, "key999999");
+    ASSERT(frozen.size == 1000000 && _value_to_number(&val) == 999999.0,
+           "freeze a million keys",
+           "frozen.size == 1000000 && _value_to_number(&val) == 999999.0");
+    hashmap_frozen_free(&frozen);
+    hashmap_free(&map);
+
+    return EXIT_SUCCESS;
+}
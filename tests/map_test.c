@@ -31,6 +31,25 @@ void _print_buckets(hashmap_t *map)
     printf("\n");
 }
 
+static int budget_evictions;
+
+// Makes room by deleting the oldest of the "mem%d" keys.
+bool evict_oldest(hashmap_t *map, size_t over)
+{
+    char key[24];
+    sprintf(key, "mem%d", budget_evictions++);
+    return hashmap_delete(map, key);
+}
+
+static hashmap_resize_t resizes[16];
+static int resize_events;
+
+void record_resize(hashmap_t *map, bool done, const hashmap_resize_t *resize)
+{
+    if (resize_events < 16)
+        resizes[resize_events++] = *resize;
+}
+
 int main(int argc, char **argv)
 {
     hashmap_t map, empty = {0};
@@ -68,6 +87,38 @@ int main(int argc, char **argv)
 
     // _print_buckets(&map);
 
+    for (int i = 0; i < 10; i += 2) {
+        char tmp[16] = {0};
+        sprintf(tmp, "key%d", i);
+        ok = hashmap_delete(&map, tmp);
+        ASSERT(ok == true, "delete value from mapping", "ok == true");
+    }
+    ASSERT(map.buckets.size == 5, "deletes shrink the mapping size",
+           "map.buckets.size == 5");
+    ok = true;
+    for (int i = 0; i < 10; ++i) {
+        char tmp[16] = {0};
+        sprintf(tmp, "key%d", i);
+        val = hashmap_get(&map, tmp);
+        ok = ok && (i % 2 == 0 ? IS_NIL(val)
+                               : _value_to_number(&val) == (double)i);
+    }
+    ASSERT(ok == true, "remaining keys are still reachable after deletes",
+           "ok == true");
+
+    ok = hashmap_upsert(&map, "key1", _number_to_value(100.0));
+    val = hashmap_get(&map, "key1");
+    ASSERT(ok == true && _value_to_number(&val) == 100.0 &&
+                   map.buckets.size == 5,
+           "upsert replaces an existing value in place",
+           "ok == true && _value_to_number(&val) == 100.0 && size == 5");
+
+    ok = hashmap_clear(&map);
+    val = hashmap_get(&map, "key1");
+    ASSERT(ok == true && map.buckets.size == 0 && IS_NIL(val),
+           "cleared mapping is empty",
+           "ok == true && map.buckets.size == 0 && IS_NIL(val)");
+
     hashmap_free(&map);
 
     map = hashmap_init(10, 0.75, _default_hasher);
@@ -109,4 +160,85 @@ int main(int argc, char **argv)
     ASSERT(memcmp((map_value *)AS_OBJ(got), val1, sizeof(map_value)) == 0,
            "validate mapping's reference is also pointing to the free'd value",
            "memcmp((map_value *)AS_OBJ(got), val1, sizeof(map_value)) == 0");
+
+    hashmap_free(&map);
+
+    char key[24];
+    hashmap_memory_t usage;
+    size_t key_bytes = 0;
+    map = hashmap_init(16, 0.75, _default_hasher);
+    map.owns_keys = true;
+    for (int i = 0; i < 10; ++i) {
+        sprintf(key, "mem%d", i);
+        hashmap_add(&map, key, _number_to_value(i));
+        key_bytes += strlen(key) + 1;
+    }
+    hashmap_delete(&map, "mem0");
+    key_bytes -= strlen("mem0") + 1;
+    usage = hashmap_memory_usage(&map);
+    ASSERT(usage.table == 16 * sizeof(bucket_t) && usage.keys == key_bytes &&
+                   map.key_bytes == key_bytes && usage.borrowed == 0 &&
+                   usage.total == usage.table + usage.control +
+                                          usage.keys + usage.slack,
+           "memory usage accounts for the table and owned keys",
+           "usage.keys == key_bytes");
+    hashmap_free(&map);
+
+    map = hashmap_init(16, 0.75, _default_hasher);
+    hashmap_add(&map, "borrowed", TRUE_VAL);
+    usage = hashmap_memory_usage(&map);
+    ASSERT(usage.keys == 0 && usage.borrowed == strlen("borrowed") + 1,
+           "borrowed keys are reported apart", "usage.keys == 0");
+    hashmap_free(&map);
+
+    // 16 slots at 0.75 hold 12 keys, the 13th would need 32 slots.
+    map = hashmap_init(16, 0.75, _default_hasher);
+    map.owns_keys = true;
+    map.max_bytes = 16 * sizeof(bucket_t) + 12 * 6;
+    ok = true;
+    for (int i = 0; i < 12; ++i) {
+        sprintf(key, "mem%d", i);
+        ok = ok && hashmap_add(&map, key, _number_to_value(i));
+    }
+    ok = ok && !hashmap_add(&map, "mem12", TRUE_VAL) &&
+         hashmap_add(&map, "mem3", TRUE_VAL);
+    ASSERT(ok == true && map.buckets.capacity == 16 &&
+                   map.buckets.size == 12,
+           "inserts past the byte budget fail instead of growing",
+           "map.buckets.capacity == 16");
+
+    map.on_over_budget = evict_oldest;
+    ok = hashmap_add(&map, "mem12", TRUE_VAL) &&
+         hashmap_add(&map, "mem13", TRUE_VAL);
+    ASSERT(ok == true && budget_evictions == 2 && map.buckets.size == 12 &&
+                   IS_NIL(hashmap_get(&map, "mem0")) &&
+                   hashmap_get(&map, "mem13") == TRUE_VAL,
+           "the over budget hook makes room for inserts",
+           "budget_evictions == 2");
+    hashmap_free(&map);
+
+    // 100 keys grow 8 slots to 256, each resize reported before and after.
+    map = hashmap_init(8, 0.75, _default_hasher);
+    map.owns_keys = true;
+    map.on_resize = record_resize;
+    for (int i = 0; i < 100; ++i) {
+        sprintf(key, "grow%d", i);
+        hashmap_add(&map, key, _number_to_value(i));
+    }
+    ok = resize_events == 10 && map.pauses.resizes == 5;
+    uint64_t total_ns = 0, max_ns = 0;
+    for (int i = 0; ok && i < resize_events; i += 2) {
+        hashmap_resize_t *before = resizes + i, *after = resizes + i + 1;
+        ok = before->old_capacity == 8 << (i / 2) &&
+             before->new_capacity == 16 << (i / 2) && before->moved == 0 &&
+             after->old_capacity == before->old_capacity &&
+             after->moved == (int)(before->old_capacity * 0.75);
+        total_ns += after->elapsed_ns;
+        max_ns = after->elapsed_ns > max_ns ? after->elapsed_ns : max_ns;
+    }
+    ASSERT(ok == true && map.pauses.total_ns == total_ns &&
+                   map.pauses.max_ns == max_ns && max_ns > 0,
+           "resizes are reported to the hook and summed as pauses",
+           "map.pauses.resizes == 5");
+    hashmap_free(&map);
 }
@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assert.h"
+#include "map.h"
+#include "metrics.h"
+
+int main(int argc, char **argv)
+{
+    hashmap_metrics_t metrics = {0};
+    hashmap_t map;
+    char key[24];
+
+    // Buckets 5 and 8 hold 5ns and 8-9ns, bucket 40 holds 2048-2559ns.
+    metrics.latency[METRICS_GET][5] = 60;
+    metrics.latency[METRICS_GET][8] = 39;
+    metrics.latency[METRICS_GET][40] = 1;
+    ASSERT(hashmap_metrics_percentile(&metrics, METRICS_GET, 50) == 5 &&
+                   hashmap_metrics_percentile(&metrics, METRICS_GET, 99) == 9 &&
+                   hashmap_metrics_percentile(&metrics, METRICS_GET, 100) ==
+                           2559 &&
+                   hashmap_metrics_percentile(&metrics, METRICS_ADD, 50) == 0,
+           "percentiles report their bucket's upper bound",
+           "hashmap_metrics_percentile(&metrics, METRICS_GET, 99) == 9");
+
+    // 100 keys grow 8 slots to 256, five resizes.
+    map = hashmap_init(8, 0.75, _default_hasher);
+    map.owns_keys = true;
+    for (int i = 0; i < 100; ++i) {
+        sprintf(key, "metric%d", i);
+        hashmap_add(&map, key, _number_to_value(i));
+    }
+    for (int i = 0; i < 150; ++i) {
+        sprintf(key, "metric%d", i);
+        hashmap_get(&map, key);
+    }
+    hashmap_delete(&map, "metric0");
+
+#ifdef HASHMAP_METRICS
+    uint64_t gets = 0;
+    bool ok = hashmap_metrics_read(&map, &metrics);
+    for (int i = 0; i < METRICS_LATENCY_BUCKETS; ++i)
+        gets += metrics.latency[METRICS_GET][i];
+    ASSERT(ok == true && metrics.adds == 100 && metrics.gets == 150 &&
+                   metrics.hits == 100 && metrics.misses == 50 &&
+                   metrics.deletes == 1 && metrics.resizes == 5 &&
+                   gets == 150 && metrics.rehash_ns > 0,
+           "operations are counted and timed", "metrics.gets == 150");
+
+    hashmap_metrics_reset(&map);
+    ok = hashmap_metrics_read(&map, &metrics);
+    ASSERT(ok == true && metrics.adds == 0 && metrics.probe_steps == 0,
+           "reset clears the metrics", "metrics.adds == 0");
+#else
+    ASSERT(hashmap_metrics_read(&map, &metrics) == false,
+           "metrics are unavailable when compiled out",
+           "hashmap_metrics_read(&map, &metrics) == false");
+#endif
+    hashmap_free(&map);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assert.h"
+#include "map.h"
+#include "pool.h"
+
+#define THREADS 4
+#define KEYS 200000
+
+static _Atomic int ran[THREADS];
+
+void mark(void *arg, int worker, int workers)
+{
+    if (workers == THREADS)
+        atomic_fetch_add(ran + worker, 1);
+}
+
+int main(int argc, char **argv)
+{
+    hashmap_pool_t *pool;
+    hashmap_t map;
+    bool ok;
+
+    pool = hashmap_pool_open(THREADS);
+    ASSERT(pool != NULL && pool->nworkers == THREADS - 1, "open worker pool",
+           "pool != NULL && pool->nworkers == THREADS - 1");
+
+    hashmap_pool_run(pool, mark, NULL);
+    hashmap_pool_run(pool, mark, NULL);
+    ok = true;
+    for (int i = 0; i < THREADS; ++i)
+        ok = ok && atomic_load(ran + i) == 2;
+    ASSERT(ok == true, "every worker runs each task once", "ok == true");
+
+    // Starting small means the later resizes go through the pool.
+    char **keys = (char **)calloc(KEYS, sizeof(char *));
+    map = hashmap_init(64, 0.75, _default_hasher);
+    map.pool = pool;
+    ok = true;
+    for (int i = 0; i < KEYS; ++i) {
+        keys[i] = (char *)calloc(24, sizeof(char));
+        sprintf(keys[i], "key%d", i);
+        ok = ok && hashmap_add(&map, keys[i], _number_to_value((double)i));
+    }
+    ASSERT(ok == true && map.buckets.capacity >= POOL_REHASH_MIN_SLOTS &&
+                   map.buckets.size == KEYS,
+           "parallel rehash keeps every key",
+           "map.buckets.capacity >= POOL_REHASH_MIN_SLOTS");
+
+    ok = true;
+    for (int i = 0; i < KEYS; ++i) {
+        value_t val = hashmap_get(&map, keys[i]);
+        ok = ok && _value_to_number(&val) == (double)i;
+    }
+    ASSERT(ok == true, "keys are found after a parallel rehash", "ok == true");
+
+    // Deletes re-house the rest of a cluster, which relies on the layout
+    // matching the serial hasher exactly.
+    ok = true;
+    for (int i = 0; i < KEYS; i += 2)
+        ok = ok && hashmap_delete(&map, keys[i]);
+    for (int i = 0; i < KEYS; ++i) {
+        value_t val = hashmap_get(&map, keys[i]);
+        ok = ok && (i % 2 == 0 ? IS_NIL(val)
+                               : _value_to_number(&val) == (double)i);
+    }
+    ASSERT(ok == true && hashmap_rehash_parallel(&map, pool) &&
+                   map.buckets.size == KEYS / 2,
+           "deletes and rehashes after a parallel rehash",
+           "map.buckets.size == KEYS / 2");
+
+    hashmap_free(&map);
+    hashmap_pool_close(pool);
+    return EXIT_SUCCESS;
+}
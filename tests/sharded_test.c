@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#define _POSIX_C_SOURCE 200809L // pthread_rwlock_t
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assert.h"
+#include "map.h"
+#include "sharded.h"
+
+#define THREADS 8
+#define PER_THREAD 5000
+
+typedef struct worker_t {
+    hashmap_sharded_t *map;
+    int id;
+    bool ok;
+} worker_t;
+
+void *writer(void *arg)
+{
+    worker_t *w = (worker_t *)arg;
+    w->ok = true;
+    for (int i = 0; i < PER_THREAD; ++i) {
+        char *buf = (char *)calloc(24, sizeof(char));
+        int n = w->id * PER_THREAD + i;
+        sprintf(buf, "key%d", n);
+        w->ok = hashmap_sharded_add(w->map, buf, _number_to_value((double)n)) &&
+                w->ok;
+    }
+    return NULL;
+}
+
+void *reader(void *arg)
+{
+    worker_t *w = (worker_t *)arg;
+    w->ok = true;
+    for (int i = 0; i < THREADS * PER_THREAD; ++i) {
+        char tmp[24] = {0};
+        sprintf(tmp, "key%d", i);
+        value_t val = hashmap_sharded_get(w->map, tmp);
+        w->ok = w->ok && _value_to_number(&val) == (double)i;
+    }
+    return NULL;
+}
+
+bool run(void *(*fn)(void *), hashmap_sharded_t *map)
+{
+    pthread_t threads[THREADS];
+    worker_t workers[THREADS];
+    bool ok = true;
+    for (int i = 0; i < THREADS; ++i) {
+        workers[i].map = map;
+        workers[i].id = i;
+        pthread_create(&threads[i], NULL, fn, &workers[i]);
+    }
+    for (int i = 0; i < THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+        ok = ok && workers[i].ok;
+    }
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    shard_lock_t kinds[2] = {SHARD_LOCK_SPIN, SHARD_LOCK_RWLOCK};
+    hashmap_sharded_t map;
+    value_t val;
+    bool ok;
+
+    for (int k = 0; k < 2; ++k) {
+        map = hashmap_sharded_init(12, 64, 0.6, _default_hasher, kinds[k]);
+        ASSERT(map.shards != NULL && map.nshards == 16,
+               "shard count is rounded up to a power of two",
+               "map.shards != NULL && map.nshards == 16");
+
+        ASSERT(run(writer, &map), "concurrent adds from every thread succeed",
+               "run(writer, &map)");
+        ASSERT(run(reader, &map), "concurrent gets see every added value",
+               "run(reader, &map)");
+
+        int total = 0;
+        for (int i = 0; i < map.nshards; ++i)
+            total += map.shards[i].map.buckets.size;
+        ASSERT(total == THREADS * PER_THREAD,
+               "keys are spread over independently resized shards",
+               "total == THREADS * PER_THREAD");
+
+        hashmap_sharded_upsert(&map, "key1", _number_to_value(-1.0));
+        val = hashmap_sharded_get(&map, "key1");
+        ASSERT(_value_to_number(&val) == -1.0, "upsert through the shard lock",
+               "_value_to_number(&val) == -1.0");
+        ASSERT(hashmap_sharded_delete(&map, "key1") &&
+                       IS_NIL(hashmap_sharded_get(&map, "key1")),
+               "delete through the shard lock",
+               "hashmap_sharded_delete(&map, \"key1\") && IS_NIL(...)");
+
+        double prev = -1;
+        ok = hashmap_sharded_fetch_add_number(&map, "hits", 2, &prev) &&
+             prev == 0 &&
+             hashmap_sharded_fetch_add_number(&map, "hits", 3, &prev) &&
+             prev == 2 &&
+             hashmap_sharded_cas(&map, "hits", _number_to_value(5), TRUE_VAL) &&
+             !hashmap_sharded_cas(&map, "hits", FALSE_VAL, NIL_VAL) &&
+             !hashmap_sharded_fetch_add_number(&map, "hits", 1, NULL) &&
+             hashmap_sharded_exchange(&map, "hits", NIL_VAL) == TRUE_VAL &&
+             IS_NIL(hashmap_sharded_get(&map, "hits"));
+        ASSERT(ok == true, "atomic updates through the shard lock",
+               "ok == true");
+
+        hashmap_sharded_clear(&map);
+        ASSERT(IS_NIL(hashmap_sharded_get(&map, "key2")),
+               "cleared sharded map is empty",
+               "IS_NIL(hashmap_sharded_get(&map, \"key2\"))");
+        hashmap_sharded_free(&map);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#define _XOPEN_SOURCE 700 // mkstemp
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "assert.h"
+#include "map.h"
+#include "snapshot.h"
+
+int main(int argc, char **argv)
+{
+    hashmap_t map;
+    hashmap_image_t image;
+    value_t val;
+    bool ok;
+
+    char path[] = "/tmp/hashmap_snapshot_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT(fd >= 0, "create temporary snapshot file", "fd >= 0");
+    close(fd);
+
+    map = hashmap_init(16, 0.6, _default_hasher);
+    static char *buf;
+    for (int i = 0; i < 1000; ++i) {
+        buf = (char *)calloc(16, sizeof(char));
+        sprintf(buf, "key%d", i);
+        hashmap_add(&map, buf, _number_to_value((double)i));
+    }
+
+    ASSERT(hashmap_save(&map, path), "save map to snapshot image",
+           "hashmap_save(&map, path)");
+    hashmap_free(&map);
+
+    image = hashmap_open_mmap(path);
+    ASSERT(image.base != NULL && image.header->count == 1000,
+           "open snapshot image with mmap",
+           "image.base != NULL && image.header->count == 1000");
+    ASSERT(hashmap_image_verify(&image), "snapshot image checksum matches",
+           "hashmap_image_verify(&image)");
+
+    ok = true;
+    for (int i = 0; i < 1000; ++i) {
+        char tmp[16] = {0};
+        sprintf(tmp, "key%d", i);
+        val = hashmap_image_get(&image, tmp);
+        ok = ok && _value_to_number(&val) == (double)i;
+    }
+    ASSERT(ok == true, "validate every value served from the image",
+           "ok == true");
+    val = hashmap_image_get(&image, "key1000");
+    ASSERT(IS_NIL(val), "missing key returns NIL_VAL from the image",
+           "IS_NIL(val)");
+
+    // Saving over a mapped image replaces the file rather than rewriting it,
+    // so the old mapping is left whole.
+    map = hashmap_init(16, 0.6, _default_hasher);
+    hashmap_add(&map, "fresh", TRUE_VAL);
+    ASSERT(hashmap_save(&map, path), "save a new image over a mapped one",
+           "hashmap_save(&map, path)");
+    hashmap_free(&map);
+    val = hashmap_image_get(&image, "key999");
+    ASSERT(hashmap_image_verify(&image) && _value_to_number(&val) == 999.0,
+           "mapped image is untouched by the save",
+           "hashmap_image_verify(&image) && _value_to_number(&val) == 999.0");
+    hashmap_image_close(&image);
+    image = hashmap_open_mmap(path);
+    ASSERT(image.base != NULL && image.header->count == 1,
+           "reopening the path maps the new image",
+           "image.base != NULL && image.header->count == 1");
+    hashmap_image_close(&image);
+
+    // Flip a byte in the key blob, the header still opens but the checksum
+    // no longer matches.
+    FILE *fp = fopen(path, "r+b");
+    fseek(fp, -2, SEEK_END);
+    fputc('#', fp);
+    fclose(fp);
+    image = hashmap_open_mmap(path);
+    ASSERT(image.base != NULL && !hashmap_image_verify(&image),
+           "corrupted snapshot image fails verification",
+           "image.base != NULL && !hashmap_image_verify(&image)");
+    hashmap_image_close(&image);
+
+    unlink(path);
+    image = hashmap_open_mmap(path);
+    ASSERT(image.base == NULL, "opening a missing image fails",
+           "image.base == NULL");
+
+    return EXIT_SUCCESS;
+}
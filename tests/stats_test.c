@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assert.h"
+#include "map.h"
+#include "stats.h"
+#include "xxhash.h"
+
+#define KEYS 100000
+
+uint64_t identity_hasher(hashmap_t *map, const char *key, const int len)
+{
+    return _default_hasher(map, key, len);
+}
+
+int main(int argc, char **argv)
+{
+    hashmap_t map = hashmap_init(1024, 0.75, _default_hasher);
+    hashmap_stats_t stats, sampled;
+    char **keys = (char **)calloc(KEYS, sizeof(char *));
+    bool ok;
+
+    for (int i = 0; i < KEYS; ++i) {
+        keys[i] = (char *)calloc(24, sizeof(char));
+        sprintf(keys[i], "stats%d", i);
+        hashmap_add(&map, keys[i], _number_to_value(i));
+    }
+
+    // Work the expected figures out slot by slot.
+    uint64_t capacity = (uint64_t)map.buckets.capacity, distances = 0;
+    int probe_max = 0, longest = 0, run = 0, wrapped = 0;
+    for (uint64_t i = 0; i < capacity; ++i) {
+        const char *key = map.buckets.array[i].key;
+        if (key == NULL) {
+            run = 0;
+            continue;
+        }
+        uint64_t home = XXH64(key, strlen(key), 0) % capacity;
+        int distance = (int)((i + capacity - home) % capacity);
+        distances += distance;
+        probe_max = distance > probe_max ? distance : probe_max;
+        longest = ++run > longest ? run : longest;
+        wrapped += i == capacity - 1 ? run : 0;
+    }
+    for (uint64_t i = 0; wrapped > 0 && map.buckets.array[i].key != NULL; ++i)
+        longest = ++wrapped > longest ? wrapped : longest;
+
+    ok = hashmap_stats(&map, &stats);
+    uint64_t counted = 0;
+    for (int i = 0; i < STATS_PROBE_BUCKETS; ++i)
+        counted += stats.probe_histogram[i];
+    ASSERT(ok == true && stats.size == KEYS && stats.entries == KEYS &&
+                   counted == KEYS && stats.examined == (int)capacity &&
+                   stats.load_factor == (double)KEYS / (double)capacity,
+           "stats count every entry once", "stats.entries == KEYS");
+
+    ASSERT(stats.probe_max == probe_max && stats.longest_cluster == longest &&
+                   stats.probe_mean == (double)distances / KEYS &&
+                   stats.probe_p99 <= stats.probe_max &&
+                   stats.expected_miss_probes >= 1.0,
+           "probe distances and clusters match a slot by slot walk",
+           "stats.longest_cluster == longest");
+
+    ok = hashmap_stats_sampled(&map, &sampled, 8);
+    ASSERT(ok == true && sampled.size == KEYS && sampled.entries > 0 &&
+                   sampled.entries < KEYS / 4 &&
+                   sampled.longest_cluster <= stats.longest_cluster,
+           "sampled stats walk a fraction of the table",
+           "sampled.entries < KEYS / 4");
+    hashmap_free(&map);
+
+    map = hashmap_init(16, 0.75, identity_hasher);
+    ASSERT(hashmap_stats(&map, &stats) == false,
+           "stats need the default hasher's layout",
+           "hashmap_stats(&map, &stats) == false");
+    hashmap_free(&map);
+
+    for (int i = 0; i < KEYS; ++i)
+        free(keys[i]);
+    free(keys);
+    return EXIT_SUCCESS;
+}
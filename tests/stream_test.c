@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assert.h"
+#include "map.h"
+#include "stream.h"
+
+typedef struct membuf_t {
+    char *data;
+    size_t len, cap, pos;
+} membuf_t;
+
+size_t membuf_write(void *ctx, const void *buf, size_t len)
+{
+    membuf_t *mem = (membuf_t *)ctx;
+    if (mem->len + len > mem->cap) {
+        size_t cap = (mem->len + len) * 2;
+        char *grown = (char *)realloc(mem->data, cap);
+        if (grown == NULL)
+            return 0;
+        mem->data = grown;
+        mem->cap = cap;
+    }
+    memcpy(mem->data + mem->len, buf, len);
+    mem->len += len;
+    return len;
+}
+
+size_t membuf_read(void *ctx, void *buf, size_t len)
+{
+    membuf_t *mem = (membuf_t *)ctx;
+    if (mem->pos + len > mem->len)
+        len = mem->len - mem->pos;
+    memcpy(buf, mem->data + mem->pos, len);
+    mem->pos += len;
+    return len;
+}
+
+int main(int argc, char **argv)
+{
+    hashmap_t map, loaded;
+    membuf_t mem = {0};
+    value_t val;
+    bool ok;
+
+    map = hashmap_init(16, 0.6, _default_hasher);
+    static char *buf;
+    for (int i = 0; i < 20000; ++i) {
+        buf = (char *)calloc(16, sizeof(char));
+        sprintf(buf, "key%d", i);
+        hashmap_add(&map, buf, _number_to_value((double)i));
+    }
+
+    ASSERT(hashmap_dump_stream(&map, membuf_write, &mem),
+           "dump map into a stream",
+           "hashmap_dump_stream(&map, membuf_write, &mem)");
+
+    loaded = hashmap_load_stream(membuf_read, &mem);
+    ASSERT(loaded.buckets.array != NULL && loaded.owns_keys,
+           "load map back from the stream",
+           "loaded.buckets.array != NULL && loaded.owns_keys");
+
+    ok = true;
+    for (int i = 0; i < 20000; ++i) {
+        char tmp[16] = {0};
+        sprintf(tmp, "key%d", i);
+        val = hashmap_get(&loaded, tmp);
+        ok = ok && _value_to_number(&val) == (double)i;
+    }
+    ASSERT(ok == true, "validate every value in the loaded map", "ok == true");
+    ASSERT(loaded.buckets.capacity * loaded.buckets.load_factor_pct >= 20000,
+           "loaded map was presized from the stream header",
+           "loaded.buckets.capacity * loaded.buckets.load_factor_pct >= 20000");
+    hashmap_free(&loaded);
+
+    // Corrupt a byte in the middle of the first chunk's payload.
+    mem.data[sizeof(stream_header_t) + sizeof(stream_chunk_t) + 64] ^= 0x5a;
+    mem.pos = 0;
+    loaded = hashmap_load_stream(membuf_read, &mem);
+    ASSERT(loaded.buckets.array == NULL,
+           "corrupted chunk checksum fails the load",
+           "loaded.buckets.array == NULL");
+
+    // Truncated streams (no terminating chunk) fail too.
+    mem.data[sizeof(stream_header_t) + sizeof(stream_chunk_t) + 64] ^= 0x5a;
+    mem.len -= sizeof(stream_chunk_t);
+    mem.pos = 0;
+    loaded = hashmap_load_stream(membuf_read, &mem);
+    ASSERT(loaded.buckets.array == NULL, "truncated stream fails the load",
+           "loaded.buckets.array == NULL");
+
+    free(mem.data);
+    hashmap_free(&map);
+
+    return EXIT_SUCCESS;
+}
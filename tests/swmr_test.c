@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assert.h"
+#include "swmr.h"
+
+#define READERS 6
+#define STABLE 2000
+#define CHURN 2000
+
+typedef struct worker_t {
+    hashmap_swmr_t *map;
+    char **keys;
+    _Atomic bool *done;
+    bool ok;
+} worker_t;
+
+// The first STABLE keys are never deleted and must be found by every get, the
+// churned keys may be missing but never hold a value other than their own.
+void *reader(void *arg)
+{
+    worker_t *w = (worker_t *)arg;
+    swmr_reader_t *handle = hashmap_swmr_register(w->map);
+    w->ok = handle != NULL;
+    while (w->ok && !atomic_load(w->done)) {
+        for (int i = 0; i < STABLE + CHURN; ++i) {
+            value_t val = hashmap_swmr_get(w->map, handle, w->keys[i]);
+            if (i < STABLE)
+                w->ok = w->ok && _value_to_number(&val) == (double)i;
+            else
+                w->ok = w->ok &&
+                        (IS_NIL(val) || _value_to_number(&val) == (double)i);
+        }
+    }
+    hashmap_swmr_unregister(w->map, handle);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    pthread_t threads[READERS];
+    worker_t workers[READERS];
+    _Atomic bool done = false;
+    hashmap_swmr_t map;
+    bool ok;
+
+    char **keys = (char **)calloc(STABLE + CHURN, sizeof(char *));
+    for (int i = 0; i < STABLE + CHURN; ++i) {
+        keys[i] = (char *)calloc(24, sizeof(char));
+        sprintf(keys[i], "key%d", i);
+    }
+
+    map = hashmap_swmr_init(16, 0.6);
+    ASSERT(map.readers != NULL, "create swmr map", "map.readers != NULL");
+    for (int i = 0; i < STABLE; ++i)
+        hashmap_swmr_add(&map, keys[i], _number_to_value((double)i));
+
+    for (int i = 0; i < READERS; ++i) {
+        workers[i].map = &map;
+        workers[i].keys = keys;
+        workers[i].done = &done;
+        pthread_create(&threads[i], NULL, reader, &workers[i]);
+    }
+
+    // Single writer, grows the table several times and keeps deleting keys
+    // out of the middle of probe clusters while the readers run.
+    ok = true;
+    for (int round = 0; round < 20; ++round) {
+        for (int i = STABLE; i < STABLE + CHURN; ++i)
+            ok = hashmap_swmr_add(&map, keys[i], _number_to_value((double)i)) &&
+                 ok;
+        for (int i = STABLE; i < STABLE + CHURN; ++i)
+            ok = hashmap_swmr_delete(&map, keys[i]) && ok;
+        for (int i = 0; i < STABLE; ++i)
+            ok = hashmap_swmr_upsert(&map, keys[i],
+                                     _number_to_value((double)i)) &&
+                 ok;
+    }
+    atomic_store(&done, true);
+
+    for (int i = 0; i < READERS; ++i) {
+        pthread_join(threads[i], NULL);
+        ok = ok && workers[i].ok;
+    }
+    ASSERT(ok == true, "readers stay consistent with a concurrent writer",
+           "ok == true");
+
+    hashmap_swmr_synchronize(&map);
+    ASSERT(map.retired == NULL && map.size == STABLE,
+           "retired tables are reclaimed once readers quiesce",
+           "map.retired == NULL && map.size == STABLE");
+
+    hashmap_swmr_clear(&map);
+    swmr_reader_t *handle = hashmap_swmr_register(&map);
+    ASSERT(IS_NIL(hashmap_swmr_get(&map, handle, keys[0])),
+           "cleared swmr map is empty",
+           "IS_NIL(hashmap_swmr_get(&map, handle, keys[0]))");
+    hashmap_swmr_unregister(&map, handle);
+    hashmap_swmr_free(&map);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+// SPDX-License-Identifier: (BSD-3-Clause)
+// Copyright 2024 (c) Harry Law <h5law>
+// https://github.com/h5law/hashmap
+
+#define _XOPEN_SOURCE 700 // mkstemp
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "assert.h"
+#include "map.h"
+#include "wal.h"
+
+bool check_map(hashmap_t *map)
+{
+    bool ok = true;
+    for (int i = 0; i < 2000; ++i) {
+        char tmp[16] = {0};
+        sprintf(tmp, "key%d", i);
+        value_t val = hashmap_get(map, tmp);
+        if (i % 3 == 0)
+            ok = ok && IS_NIL(val); // deleted
+        else if (i % 3 == 1)
+            ok = ok && _value_to_number(&val) == (double)-i; // upserted
+        else
+            ok = ok && _value_to_number(&val) == (double)i;
+    }
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    hashmap_t map, recovered;
+    struct stat st;
+    off_t before;
+
+    char path[] = "/tmp/hashmap_wal_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT(fd >= 0, "create temporary log file", "fd >= 0");
+    close(fd);
+
+    map = hashmap_init(16, 0.6, _default_hasher);
+    map.wal = hashmap_wal_open(path, 64);
+    ASSERT(map.wal != NULL, "open mutation log", "map.wal != NULL");
+
+    static char *buf;
+    for (int i = 0; i < 2000; ++i) {
+        buf = (char *)calloc(16, sizeof(char));
+        sprintf(buf, "key%d", i);
+        hashmap_add(&map, buf, _number_to_value((double)i));
+    }
+    for (int i = 0; i < 2000; ++i) {
+        char tmp[16] = {0};
+        sprintf(tmp, "key%d", i);
+        if (i % 3 == 0)
+            hashmap_delete(&map, tmp);
+        else if (i % 3 == 1)
+            hashmap_upsert(&map, tmp, _number_to_value((double)-i));
+    }
+    ASSERT(map.wal->committed >= 3264 && map.wal->pending < 64,
+           "records are committed in groups",
+           "map.wal->committed >= 3264 && map.wal->pending < 64");
+    ASSERT(check_map(&map), "validate live map after mutations",
+           "check_map(&map)");
+    ASSERT(hashmap_wal_close(map.wal), "close log commits pending records",
+           "hashmap_wal_close(map.wal)");
+    map.wal = NULL;
+
+    recovered = hashmap_wal_recover(path, 0.6);
+    ASSERT(recovered.buckets.array != NULL && check_map(&recovered),
+           "replayed log matches the live map",
+           "recovered.buckets.array != NULL && check_map(&recovered)");
+    hashmap_free(&recovered);
+
+    // Simulate a torn write at the tail of the log.
+    FILE *fp = fopen(path, "ab");
+    fwrite("torn record", 1, 11, fp);
+    fclose(fp);
+    recovered = hashmap_wal_recover(path, 0.6);
+    ASSERT(recovered.buckets.array != NULL && check_map(&recovered),
+           "replay stops cleanly at a torn tail",
+           "recovered.buckets.array != NULL && check_map(&recovered)");
+
+    recovered.wal = hashmap_wal_open(path, 0);
+    stat(path, &st);
+    before = st.st_size;
+    ASSERT(recovered.wal != NULL && hashmap_wal_compact(&recovered),
+           "compact log into a fresh snapshot",
+           "recovered.wal != NULL && hashmap_wal_compact(&recovered)");
+    stat(path, &st);
+    ASSERT(st.st_size < before, "compacted log is smaller",
+           "st.st_size < before");
+    hashmap_upsert(&recovered, "key2", _number_to_value(2.0));
+    hashmap_wal_close(recovered.wal);
+    recovered.wal = NULL;
+    hashmap_free(&recovered);
+
+    recovered = hashmap_wal_recover(path, 0.6);
+    ASSERT(recovered.buckets.array != NULL && check_map(&recovered),
+           "replayed compacted log matches the live map",
+           "recovered.buckets.array != NULL && check_map(&recovered)");
+    hashmap_free(&recovered);
+
+    hashmap_free(&map);
+    unlink(path);
+
+    // Adds rejected by the byte budget must not be replayed into the
+    // recovered map, which has no budget of its own.
+    char keys[20][16];
+    int accepted = 0;
+    fd = mkstemp(path);
+    close(fd);
+    map = hashmap_init(16, 0.75, _default_hasher);
+    map.max_bytes = 16 * sizeof(bucket_t); // 12 keys before growing
+    map.wal = hashmap_wal_open(path, 0);
+    for (int i = 0; i < 20; ++i) {
+        sprintf(keys[i], "key%d", i);
+        accepted += hashmap_add(&map, keys[i], _number_to_value((double)i));
+    }
+    hashmap_upsert(&map, "key19", TRUE_VAL);
+    hashmap_wal_close(map.wal);
+    map.wal = NULL;
+    recovered = hashmap_wal_recover(path, 0.75);
+    ASSERT(accepted == 12 && recovered.buckets.size == map.buckets.size &&
+                   IS_NIL(hashmap_get(&recovered, "key19")),
+           "rejected adds are not logged",
+           "accepted == 12 && recovered.buckets.size == map.buckets.size && "
+           "IS_NIL(hashmap_get(&recovered, \"key19\"))");
+    hashmap_free(&recovered);
+    hashmap_free(&map);
+    unlink(path);
+
+    // Many records for a single key should not presize a huge table.
+    fd = mkstemp(path);
+    close(fd);
+    map = hashmap_init(16, 0.75, _default_hasher);
+    map.wal = hashmap_wal_open(path, 0);
+    for (int i = 0; i < 200000; ++i)
+        hashmap_upsert(&map, "key0", _number_to_value((double)i));
+    hashmap_wal_close(map.wal);
+    map.wal = NULL;
+    recovered = hashmap_wal_recover(path, 0.75);
+    ASSERT(recovered.buckets.size == 1 &&
+                   recovered.buckets.capacity < 200000,
+           "recovery presizes from a bounded key count",
+           "recovered.buckets.size == 1 && "
+           "recovered.buckets.capacity < 200000");
+    hashmap_free(&recovered);
+    hashmap_free(&map);
+    unlink(path);
+
+    // A log of many distinct keys replays without growing the table.
+    fd = mkstemp(path);
+    close(fd);
+    map = hashmap_init(16, 0.75, _default_hasher);
+    map.owns_keys = true;
+    map.wal = hashmap_wal_open(path, 1024);
+    for (int i = 0; i < 200000; ++i) {
+        char tmp[16] = {0};
+        sprintf(tmp, "key%d", i);
+        hashmap_add(&map, tmp, _number_to_value((double)i));
+        hashmap_upsert(&map, tmp, _number_to_value((double)-i));
+    }
+    hashmap_wal_close(map.wal);
+    map.wal = NULL;
+    recovered = hashmap_wal_recover(path, 0.75);
+    ASSERT(recovered.buckets.size == 200000 && recovered.pauses.resizes == 0,
+           "recovery presizes for every distinct key",
+           "recovered.buckets.size == 200000 && "
+           "recovered.pauses.resizes == 0");
+    hashmap_free(&recovered);
+    hashmap_free(&map);
+    unlink(path);
+
+    return EXIT_SUCCESS;
+}